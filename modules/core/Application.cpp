@@ -1,6 +1,7 @@
 #include "core/Application.h"
 #include "rendering/PixelBuffer.h"
 #include "world/World.h"
+#include "world/WorldSnapshot.h"
 #include "materials/Materials.h"
 #include "input/InputSystem.h"
 #include "input/InputManager.h"
@@ -8,6 +9,8 @@
 #include <chrono>
 #include <cstdlib>
 #include <ctime>
+#include <thread>
+#include <algorithm>
 
 Application::Application(const std::string& title, int width, int height)
     : m_title(title)
@@ -17,7 +20,14 @@ Application::Application(const std::string& title, int width, int height)
     , m_initialized(false)
     , m_window(nullptr)
     , m_glContext(nullptr)
-    , m_accumulator(0.0f) {
+    , m_accumulator(0.0f)
+    , m_lockstep(false)
+    , m_seed(0) {
+}
+
+void Application::EnableLockstep(uint64_t seed) {
+    m_lockstep = true;
+    m_seed = seed;
 }
 
 Application::~Application() {
@@ -69,9 +79,6 @@ bool Application::Initialize() {
     std::cout << "OpenGL Version: " << glGetString(GL_VERSION) << std::endl;
     std::cout << "GLSL Version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
     
-    // Initialize random seed
-    std::srand(std::time(nullptr));
-    
     // Create pixel buffer (lower resolution for performance)
     int simWidth = m_width / 4;
     int simHeight = m_height / 4;
@@ -79,18 +86,26 @@ bool Application::Initialize() {
     
     // Create world
     m_world = std::make_unique<World>(simWidth, simHeight);
+    m_world->SetThreadCount(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+    m_world->SetSeed(m_lockstep ? m_seed : static_cast<uint64_t>(std::time(nullptr)));
+    // The view covers the whole world; a scrolling camera would move this
+    m_world->AddFocusRect(0, 0, simWidth - 1, simHeight - 1);
+    m_snapshot = std::make_unique<WorldSnapshot>(simWidth, simHeight);
     
     // Create input system
     m_inputSystem = std::make_unique<Funhouse::InputSystem>();
     m_inputManager = std::make_unique<Funhouse::InputManager>(m_inputSystem.get(), m_world.get());
     m_inputManager->Initialize();
+    m_inputSystem->SetWorld(m_world.get());
+    m_inputSystem->SetLockstep(m_lockstep);
     
     // Print controls
     std::cout << "\n=== Funhouse Controls ===" << std::endl;
     std::cout << "Mouse: Left click to draw, Right click to erase" << std::endl;
-    std::cout << "1-4: Select materials (Air, Sand, Water, Stone)" << std::endl;
+    std::cout << "1-6: Select materials (Air, Sand, Water, Stone, Lava, Fire)" << std::endl;
     std::cout << "+/-: Increase/decrease brush size" << std::endl;
     std::cout << "C: Clear world" << std::endl;
+    std::cout << "Z/Y: Undo/redo (off with --seed)" << std::endl;
     std::cout << "R: Toggle recording" << std::endl;
     std::cout << "P: Playback recording" << std::endl;
     std::cout << "ESC: Exit" << std::endl;
@@ -98,24 +113,13 @@ bool Application::Initialize() {
     
     // Add some initial materials
     // Create ground
-    for (int x = 0; x < simWidth; x++) {
-        m_world->SetPixel(x, simHeight - 1, MaterialType::Stone);
-        m_world->SetPixel(x, simHeight - 2, MaterialType::Stone);
-    }
+    m_world->FillRect(0, simHeight - 2, simWidth - 1, simHeight - 1, MaterialType::Stone);
     
     // Add some sand
-    for (int x = simWidth/4; x < simWidth/2; x++) {
-        for (int y = 0; y < 20; y++) {
-            m_world->SetPixel(x, y + 10, MaterialType::Sand);
-        }
-    }
+    m_world->FillRect(simWidth/4, 10, simWidth/2 - 1, 29, MaterialType::Sand);
     
     // Add some water
-    for (int x = simWidth/2; x < 3*simWidth/4; x++) {
-        for (int y = 0; y < 15; y++) {
-            m_world->SetPixel(x, y + 20, MaterialType::Water);
-        }
-    }
+    m_world->FillRect(simWidth/2, 20, 3*simWidth/4 - 1, 34, MaterialType::Water);
 
     m_initialized = true;
     m_running = true;
@@ -210,40 +214,60 @@ void Application::Update(float deltaTime) {
         m_inputSystem->ExecuteCommands();
     }
     
-    // Update the world simulation
+    // Update the world simulation and publish the finished frame for Render
     if (m_world) {
         m_world->Update();
+        m_snapshot->Publish(*m_world);
+
+        if (m_lockstep && m_world->GetTick() % HASH_LOG_INTERVAL == 0) {
+            std::cout << "Tick " << m_world->GetTick() << " state hash " << std::hex
+                      << m_world->GetStateHash() << std::dec << std::endl;
+        }
     }
 }
 
+static uint32_t MaterialColor(MaterialType mat) {
+    switch (mat) {
+        case MaterialType::Air:
+            return 0xFF1A1A1A; // Dark gray background
+        case MaterialType::Sand:
+            return 0xFFE3B778; // Sandy yellow (ABGR format)
+        case MaterialType::Water:
+            return 0xFFB87843; // Blue water (ABGR format)
+        case MaterialType::Stone:
+            return 0xFF808080; // Gray stone
+        case MaterialType::Steam:
+            return 0xFFE0E0E0; // Pale steam
+        case MaterialType::Lava:
+            return 0xFF2010CF; // Glowing red lava
+        case MaterialType::Fire:
+            return 0xFF2080FF; // Orange flame
+    }
+    return 0xFF000000; // Default black with full alpha
+}
+
 void Application::Render() {
     glClear(GL_COLOR_BUFFER_BIT);
     
-    if (m_pixelBuffer && m_world) {
+    if (m_pixelBuffer && m_snapshot) {
+        // Render only reads published frames, never the live world
+        const WorldSnapshot::Frame& frame = m_snapshot->Acquire();
+
         // Convert world materials to colors
         std::vector<uint32_t> pixels(m_pixelBuffer->GetWidth() * m_pixelBuffer->GetHeight());
         
-        for (int y = 0; y < m_world->GetHeight(); y++) {
-            for (int x = 0; x < m_world->GetWidth(); x++) {
-                MaterialType mat = m_world->GetPixel(x, y);
-                uint32_t color = 0xFF000000; // Default black with full alpha
-                
-                switch (mat) {
-                    case MaterialType::Air:
-                        color = 0xFF1A1A1A; // Dark gray background
-                        break;
-                    case MaterialType::Sand:
-                        color = 0xFFE3B778; // Sandy yellow (ABGR format)
-                        break;
-                    case MaterialType::Water:
-                        color = 0xFFB87843; // Blue water (ABGR format)
-                        break;
-                    case MaterialType::Stone:
-                        color = 0xFF808080; // Gray stone
-                        break;
-                }
-                
-                pixels[y * m_pixelBuffer->GetWidth() + x] = color;
+        for (int y = 0; y < frame.height; y++) {
+            for (int x = 0; x < frame.width; x++) {
+                pixels[y * m_pixelBuffer->GetWidth() + x] = MaterialColor(frame.GetPixel(x, y));
+            }
+        }
+
+        // Particles in flight are drawn over the grid
+        for (const WorldSnapshot::Particle& particle : frame.particles) {
+            int x = static_cast<int>(particle.x);
+            int y = static_cast<int>(particle.y);
+            if (x >= 0 && x < frame.width && y >= 0 && y < frame.height) {
+                pixels[y * m_pixelBuffer->GetWidth() + x] = MaterialColor(particle.material);
             }
         }
         
@@ -4,9 +4,11 @@
 #include <GL/glew.h>
 #include <memory>
 #include <string>
+#include <cstdint>
 
 class PixelBuffer;
 class World;
+class WorldSnapshot;
 
 namespace Funhouse {
     class InputSystem;
@@ -28,6 +30,11 @@ public:
     bool IsRunning() const { return m_running; }
     void Quit() { m_running = false; }
 
+    // Call before Initialize. Runs with a fixed seed and tick-indexed
+    // playback, and logs the world's state hash every HASH_LOG_INTERVAL
+    // ticks, so two runs fed the same commands can be compared.
+    void EnableLockstep(uint64_t seed);
+
 private:
     void ProcessEvents();
     void Update(float deltaTime);
@@ -44,9 +51,14 @@ private:
 
     static constexpr float FIXED_TIMESTEP = 1.0f / 60.0f;
     float m_accumulator;
+
+    static constexpr uint64_t HASH_LOG_INTERVAL = 600;
+    bool m_lockstep;
+    uint64_t m_seed;
     
     std::unique_ptr<PixelBuffer> m_pixelBuffer;
     std::unique_ptr<World> m_world;
+    std::unique_ptr<WorldSnapshot> m_snapshot;
     std::unique_ptr<Funhouse::InputSystem> m_inputSystem;
     std::unique_ptr<Funhouse::InputManager> m_inputManager;
 };
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+// Counter-based random numbers. Every value is a pure function of its
+// inputs, so results do not depend on call order or on which thread asks,
+// and a run can be replayed from its seed alone.
+
+// SplitMix64 finalizer: a cheap bijective mix with good avalanche.
+inline uint64_t MixBits(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ull;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBull;
+    value ^= value >> 31;
+    return value;
+}
+
+// Per-tick key; compute once per tick and pass to CellRandom.
+inline uint64_t TickRandomKey(uint64_t seed, uint64_t tick) {
+    return MixBits(seed ^ MixBits(tick + 0x9E3779B97F4A7C15ull));
+}
+
+inline uint32_t CellRandom(uint64_t tickKey, int x, int y) {
+    uint64_t cell = (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) |
+                    static_cast<uint32_t>(y);
+    return static_cast<uint32_t>(MixBits(tickKey ^ cell) >> 32);
+}
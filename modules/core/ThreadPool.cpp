@@ -0,0 +1,89 @@
+#include "core/ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount)
+    : m_task(nullptr)
+    , m_taskCount(0)
+    , m_nextTask(0)
+    , m_busyWorkers(0)
+    , m_generation(0)
+    , m_stopping(false) {
+    int workerCount = std::max(threadCount, 1) - 1;
+    m_workers.reserve(workerCount);
+    for (int i = 0; i < workerCount; i++) {
+        m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& task) {
+    if (count <= 0) {
+        return;
+    }
+
+    if (m_workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_taskCount = count;
+        m_nextTask.store(0, std::memory_order_relaxed);
+        m_busyWorkers = static_cast<int>(m_workers.size());
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    RunTasks();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+    m_task = nullptr;
+}
+
+void ThreadPool::WorkerLoop() {
+    uint64_t seenGeneration = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+            if (m_stopping) {
+                return;
+            }
+            seenGeneration = m_generation;
+        }
+
+        RunTasks();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busyWorkers == 0) {
+            m_done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::RunTasks() {
+    for (;;) {
+        int index = m_nextTask.fetch_add(1, std::memory_order_relaxed);
+        if (index >= m_taskCount) {
+            return;
+        }
+        (*m_task)(index);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+// Persistent worker pool for data-parallel loops. Workers are created once
+// and sleep between jobs, so per-frame work never spawns threads.
+class ThreadPool {
+public:
+    // threadCount includes the calling thread; 1 runs everything inline.
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int GetThreadCount() const { return static_cast<int>(m_workers.size()) + 1; }
+
+    // Runs task(0) .. task(count - 1) across the workers and the calling
+    // thread, returning once every index has been processed.
+    void ParallelFor(int count, const std::function<void(int)>& task);
+
+private:
+    void WorkerLoop();
+    void RunTasks();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    const std::function<void(int)>* m_task;
+    int m_taskCount;
+    std::atomic<int> m_nextTask;
+    int m_busyWorkers;
+    uint64_t m_generation;
+    bool m_stopping;
+};
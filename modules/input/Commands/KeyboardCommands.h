@@ -1,8 +1,8 @@
 #pragma once
 
 #include "../InputCommand.h"
+#include "WorldCommand.h"
 #include "../../materials/Materials.h"
-#include "../../world/World.h"
 #include <functional>
 
 namespace Funhouse {
@@ -91,15 +91,13 @@ private:
     PlaybackCallback callback_;
 };
 
-class ClearWorldCommand : public InputCommand {
+class ClearWorldCommand : public WorldCommand {
 public:
     ClearWorldCommand(::World* world)
-        : world_(world) {}
+        : WorldCommand(world) {}
     
-    void Execute() override {
-        if (world_) {
-            world_->Clear();
-        }
+    void Apply() override {
+        world_->Clear();
     }
     
     std::string GetName() const override {
@@ -109,9 +107,6 @@ public:
     std::unique_ptr<InputCommand> Clone() const override {
         return std::make_unique<ClearWorldCommand>(world_);
     }
-    
-private:
-    ::World* world_;
 };
 
 } // namespace Funhouse
\ No newline at end of file
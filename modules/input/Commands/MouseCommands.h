@@ -1,20 +1,17 @@
 #pragma once
 
-#include "../InputCommand.h"
-#include "../../world/World.h"
+#include "WorldCommand.h"
 #include "../../materials/Materials.h"
 
 namespace Funhouse {
 
-class PlaceMaterialCommand : public InputCommand {
+class PlaceMaterialCommand : public WorldCommand {
 public:
     PlaceMaterialCommand(::World* world, int x, int y, MaterialType material)
-        : world_(world), x_(x), y_(y), material_(material) {}
+        : WorldCommand(world), x_(x), y_(y), material_(material) {}
     
-    void Execute() override {
-        if (world_) {
-            world_->SetPixel(x_, y_, material_);
-        }
+    void Apply() override {
+        world_->SetPixel(x_, y_, material_);
     }
     
     std::string GetName() const override {
@@ -26,21 +23,18 @@ public:
     }
     
 private:
-    ::World* world_;
     int x_;
     int y_;
     MaterialType material_;
 };
 
-class RemoveMaterialCommand : public InputCommand {
+class RemoveMaterialCommand : public WorldCommand {
 public:
     RemoveMaterialCommand(::World* world, int x, int y)
-        : world_(world), x_(x), y_(y) {}
+        : WorldCommand(world), x_(x), y_(y) {}
     
-    void Execute() override {
-        if (world_) {
-            world_->SetPixel(x_, y_, MaterialType::Air);
-        }
+    void Apply() override {
+        world_->SetPixel(x_, y_, MaterialType::Air);
     }
     
     std::string GetName() const override {
@@ -52,32 +46,20 @@ public:
     }
     
 private:
-    ::World* world_;
     int x_;
     int y_;
 };
 
-class MouseDrawCommand : public InputCommand {
+class MouseDrawCommand : public WorldCommand {
 public:
-    MouseDrawCommand(::World* world, int x, int y, int brushSize, MaterialType material, bool isErasing)
-        : world_(world), x_(x), y_(y), brushSize_(brushSize), material_(material), isErasing_(isErasing) {}
+    // Dabs of one stroke share a stroke id and are undone together.
+    MouseDrawCommand(::World* world, int x, int y, int brushSize, MaterialType material, bool isErasing,
+                     uint64_t stroke = 0)
+        : WorldCommand(world), x_(x), y_(y), brushSize_(brushSize), material_(material), isErasing_(isErasing),
+          stroke_(stroke) {}
     
-    void Execute() override {
-        if (!world_) return;
-        
-        int halfSize = brushSize_ / 2;
-        for (int dy = -halfSize; dy <= halfSize; ++dy) {
-            for (int dx = -halfSize; dx <= halfSize; ++dx) {
-                if (dx * dx + dy * dy <= halfSize * halfSize) {
-                    int px = x_ + dx;
-                    int py = y_ + dy;
-                    
-                    if (px >= 0 && px < world_->GetWidth() && py >= 0 && py < world_->GetHeight()) {
-                        world_->SetPixel(px, py, isErasing_ ? MaterialType::Air : material_);
-                    }
-                }
-            }
-        }
+    void Apply() override {
+        world_->FillCircle(x_, y_, brushSize_ / 2, isErasing_ ? MaterialType::Air : material_);
     }
     
     std::string GetName() const override {
@@ -85,16 +67,18 @@ public:
     }
     
     std::unique_ptr<InputCommand> Clone() const override {
-        return std::make_unique<MouseDrawCommand>(world_, x_, y_, brushSize_, material_, isErasing_);
+        return std::make_unique<MouseDrawCommand>(world_, x_, y_, brushSize_, material_, isErasing_, stroke_);
     }
     
+    uint64_t GetUndoGroup() const override { return stroke_; }
+    
 private:
-    ::World* world_;
     int x_;
     int y_;
     int brushSize_;
     MaterialType material_;
     bool isErasing_;
+    uint64_t stroke_;
 };
 
 } // namespace Funhouse
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../InputCommand.h"
+#include "../../world/World.h"
+#include <cstdint>
+
+namespace Funhouse {
+
+// Base for commands that change the world. Execute takes a world
+// checkpoint before Apply, and Undo restores it: every chunk written since
+// then, by this command, later commands or the simulation, goes back to
+// how it was when the command ran. Undo therefore rewinds everything that
+// happened anywhere in the world since the command. The checkpoint is
+// released when the command is destroyed, so the world must outlive the
+// command. While it is held, each chunk the world writes is copied once
+// into the newest checkpoint; when the copies outgrow the world's
+// checkpoint budget the oldest checkpoints are dropped, and their commands
+// can no longer be undone.
+class WorldCommand : public InputCommand {
+public:
+    explicit WorldCommand(::World* world) : world_(world) {}
+    WorldCommand(const WorldCommand&) = delete;
+    WorldCommand& operator=(const WorldCommand&) = delete;
+    
+    ~WorldCommand() override {
+        ReleaseCheckpoint();
+    }
+    
+    void Execute() override {
+        if (world_) {
+            ReleaseCheckpoint();
+            checkpoint_ = world_->TakeCheckpoint();
+            Apply();
+        }
+    }
+    
+    void ExecuteWithoutUndo() override {
+        if (world_) {
+            ReleaseCheckpoint();
+            Apply();
+        }
+    }
+    
+    void Undo() override {
+        if (world_ && checkpoint_) {
+            world_->RestoreCheckpoint(checkpoint_);
+            checkpoint_ = 0;
+        }
+    }
+    
+    bool IsUndoable() const override { return true; }
+    bool CanUndo() const override { return world_ && world_->HasCheckpoint(checkpoint_); }
+    
+protected:
+    virtual void Apply() = 0;
+    
+    ::World* world_;
+    
+private:
+    void ReleaseCheckpoint() {
+        if (world_ && checkpoint_) {
+            world_->ReleaseCheckpoint(checkpoint_);
+            checkpoint_ = 0;
+        }
+    }
+    
+    uint64_t checkpoint_ = 0;
+};
+
+} // namespace Funhouse
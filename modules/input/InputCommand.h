@@ -3,6 +3,7 @@
 #include <string>
 #include <memory>
 #include <chrono>
+#include <cstdint>
 
 namespace Funhouse {
 
@@ -23,10 +24,31 @@ public:
     
     Timestamp GetTimestamp() const { return timestamp_; }
     
+    // World tick the command ran before; set by InputSystem when it runs.
+    // Recorded commands hold it relative to the start of the recording.
+    uint64_t GetTick() const { return tick_; }
+    void SetTick(uint64_t tick) { tick_ = tick; }
+    
     virtual bool IsReplayable() const { return true; }
     
+    // Undoable commands are kept by InputSystem for Undo and Redo.
+    virtual bool IsUndoable() const { return false; }
+    
+    // False once Undo can no longer take the command back, e.g. because
+    // what it kept for undo was dropped to bound memory.
+    virtual bool CanUndo() const { return IsUndoable(); }
+    
+    // Undoable commands with the same non-zero group that run one after
+    // another form one undo entry, e.g. the dabs of one brush stroke.
+    virtual uint64_t GetUndoGroup() const { return 0; }
+    
+    // Runs the command without keeping what Undo needs, for commands
+    // covered by an earlier one's undo or run while undo is off.
+    virtual void ExecuteWithoutUndo() { Execute(); }
+    
 protected:
     Timestamp timestamp_;
+    uint64_t tick_ = 0;
 };
 
 using InputCommandPtr = std::unique_ptr<InputCommand>;
@@ -58,12 +58,50 @@ void InputManager::SetupContextBindings() {
             }
         );
     });
+    gameplayContext->BindKey(SDL_SCANCODE_5, [this]() {
+        return std::make_unique<SelectMaterialCommand>(
+            MaterialType::Lava,
+            [this](MaterialType mat) { 
+                selectedMaterial_ = mat;
+                std::cout << "Selected: Lava" << std::endl;
+            }
+        );
+    });
+    gameplayContext->BindKey(SDL_SCANCODE_6, [this]() {
+        return std::make_unique<SelectMaterialCommand>(
+            MaterialType::Fire,
+            [this](MaterialType mat) { 
+                selectedMaterial_ = mat;
+                std::cout << "Selected: Fire" << std::endl;
+            }
+        );
+    });
     
     // Clear world
     gameplayContext->BindKey(SDL_SCANCODE_C, [this]() {
         return std::make_unique<ClearWorldCommand>(world_);
     });
     
+    // Undo and redo world commands. Bound only here: a binding that
+    // returns no command falls through to the legacy factories.
+    gameplayContext->BindKey(SDL_SCANCODE_Z, [this]() {
+        if (inputSystem_->IsLockstep()) {
+            std::cout << "Undo is off in lockstep mode." << std::endl;
+        } else if (!inputSystem_->Undo()) {
+            std::cout << "Nothing to undo." << std::endl;
+        }
+        return nullptr;
+    });
+    
+    gameplayContext->BindKey(SDL_SCANCODE_Y, [this]() {
+        if (inputSystem_->IsLockstep()) {
+            std::cout << "Redo is off in lockstep mode." << std::endl;
+        } else if (!inputSystem_->Redo()) {
+            std::cout << "Nothing to redo." << std::endl;
+        }
+        return nullptr;
+    });
+    
     // Brush size controls
     gameplayContext->BindKey(SDL_SCANCODE_MINUS, [this]() {
         brushSize_ = std::max(1, brushSize_ - 2);
@@ -123,7 +161,7 @@ void InputManager::SetupDefaultBindings() {
     // Keep legacy bindings for backward compatibility
     // These will be overridden by context bindings
     
-    // Material selection keys (1-4)
+    // Material selection keys (1-6)
     inputSystem_->RegisterKeyCommandFactory(SDL_SCANCODE_1, 
         [this](const SDL_Event&) -> InputCommandPtr {
             return std::make_unique<SelectMaterialCommand>(
@@ -168,6 +206,28 @@ void InputManager::SetupDefaultBindings() {
             );
         });
     
+    inputSystem_->RegisterKeyCommandFactory(SDL_SCANCODE_5,
+        [this](const SDL_Event&) -> InputCommandPtr {
+            return std::make_unique<SelectMaterialCommand>(
+                MaterialType::Lava,
+                [this](MaterialType mat) { 
+                    selectedMaterial_ = mat;
+                    std::cout << "Selected: Lava" << std::endl;
+                }
+            );
+        });
+    
+    inputSystem_->RegisterKeyCommandFactory(SDL_SCANCODE_6,
+        [this](const SDL_Event&) -> InputCommandPtr {
+            return std::make_unique<SelectMaterialCommand>(
+                MaterialType::Fire,
+                [this](MaterialType mat) { 
+                    selectedMaterial_ = mat;
+                    std::cout << "Selected: Fire" << std::endl;
+                }
+            );
+        });
+    
     // Clear world
     inputSystem_->RegisterKeyCommandFactory(SDL_SCANCODE_C,
         [this](const SDL_Event&) -> InputCommandPtr {
@@ -255,7 +315,7 @@ void InputManager::HandleMouseDraw(int x, int y, bool leftButton, bool rightButt
         
         while (true) {
             auto command = std::make_unique<MouseDrawCommand>(
-                world_, x0, y0, brushSize_, selectedMaterial_, rightButton
+                world_, x0, y0, brushSize_, selectedMaterial_, rightButton, stroke_
             );
             inputSystem_->QueueCommand(std::move(command));
             
@@ -272,9 +332,10 @@ void InputManager::HandleMouseDraw(int x, int y, bool leftButton, bool rightButt
             }
         }
     } else {
-        // Just draw at current position
+        // A new stroke: just draw at current position
+        stroke_++;
         auto command = std::make_unique<MouseDrawCommand>(
-            world_, worldX, worldY, brushSize_, selectedMaterial_, rightButton
+            world_, worldX, worldY, brushSize_, selectedMaterial_, rightButton, stroke_
         );
         inputSystem_->QueueCommand(std::move(command));
     }
@@ -343,6 +404,18 @@ void InputManager::SetupTwitchCommands() {
             std::cout << "[Twitch] " << username << " selected Stone" << std::endl;
         });
     
+    twitchAdapter_->RegisterCommandCallback("lava", 
+        [this](const std::string& username, const std::string&, const std::string&) {
+            selectedMaterial_ = MaterialType::Lava;
+            std::cout << "[Twitch] " << username << " selected Lava" << std::endl;
+        });
+    
+    twitchAdapter_->RegisterCommandCallback("fire", 
+        [this](const std::string& username, const std::string&, const std::string&) {
+            selectedMaterial_ = MaterialType::Fire;
+            std::cout << "[Twitch] " << username << " selected Fire" << std::endl;
+        });
+    
     twitchAdapter_->RegisterCommandCallback("air", 
         [this](const std::string& username, const std::string&, const std::string&) {
             selectedMaterial_ = MaterialType::Air;
@@ -380,6 +453,8 @@ void InputManager::SetupTwitchCommands() {
                 if (material == "sand") mat = MaterialType::Sand;
                 else if (material == "water") mat = MaterialType::Water;
                 else if (material == "stone") mat = MaterialType::Stone;
+                else if (material == "lava") mat = MaterialType::Lava;
+                else if (material == "fire") mat = MaterialType::Fire;
                 
                 // Convert to world coordinates (assuming same scaling as mouse)
                 int worldX = x / 4;
@@ -45,6 +45,7 @@ private:
     
     int lastMouseX_ = -1;
     int lastMouseY_ = -1;
+    uint64_t stroke_ = 0; // id of the current or last brush stroke
     
     // Twitch integration
     std::unique_ptr<TwitchIrcClient> twitchClient_;
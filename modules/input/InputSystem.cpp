@@ -1,4 +1,5 @@
 #include "InputSystem.h"
+#include "../world/World.h"
 #include <algorithm>
 
 namespace Funhouse {
@@ -86,7 +87,9 @@ void InputSystem::ProcessEvent(const SDL_Event& event, ::World* world) {
 void InputSystem::Update() {
     ClearKeyboardTransitions();
     
-    if (isPlayingBack_ && playbackIndex_ < playbackCommands_.size()) {
+    if (lockstep_) {
+        QueueDuePlayback();
+    } else if (isPlayingBack_ && playbackIndex_ < playbackCommands_.size()) {
         auto now = std::chrono::steady_clock::now();
         auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
             now - playbackStartTime_).count();
@@ -110,17 +113,93 @@ void InputSystem::Update() {
     }
 }
 
+// Playback started by a command runs its first commands in the same
+// batch, matching a recording started by a command.
+void InputSystem::QueueDuePlayback() {
+    if (!isPlayingBack_ || !lockstep_) return;
+    
+    uint64_t elapsed = CurrentTick() - playbackStartTick_;
+    while (playbackIndex_ < playbackCommands_.size() &&
+           playbackCommands_[playbackIndex_]->GetTick() <= elapsed) {
+        QueueCommand(playbackCommands_[playbackIndex_]->Clone());
+        playbackIndex_++;
+    }
+    
+    if (playbackIndex_ >= playbackCommands_.size()) {
+        StopPlayback();
+    }
+}
+
 void InputSystem::ExecuteCommands() {
+    uint64_t tick = CurrentTick();
+    QueueDuePlayback();
     while (!commandQueue_.empty()) {
         auto& command = commandQueue_.front();
-        command->Execute();
+        command->SetTick(tick);
+        bool undoable = command->IsUndoable() && !lockstep_;
+        uint64_t group = command->GetUndoGroup();
+        bool joins = undoable && group != 0 && !undoHistory_.empty() && undoHistory_.back().group == group;
+        if (undoable && !joins) {
+            command->Execute();
+        } else {
+            command->ExecuteWithoutUndo();
+        }
         
         if (isRecording_ && command->IsReplayable()) {
             recordedCommands_.push_back(command->Clone());
+            recordedCommands_.back()->SetTick(tick - recordingStartTick_);
+        }
+        
+        if (undoable) {
+            redoHistory_.clear();
+            if (!joins) {
+                undoHistory_.push_back({group, {}});
+                if (undoHistory_.size() > MAX_UNDO_HISTORY) {
+                    undoHistory_.pop_front();
+                }
+            }
+            undoHistory_.back().commands.push_back(std::move(command));
         }
         
         commandQueue_.pop();
+        if (commandQueue_.empty()) {
+            QueueDuePlayback();
+        }
     }
+    DropExpiredUndo();
+}
+
+// Only the oldest entries expire, since the world drops its oldest
+// checkpoints first.
+void InputSystem::DropExpiredUndo() {
+    while (!undoHistory_.empty() && !undoHistory_.front().commands.front()->CanUndo()) {
+        undoHistory_.pop_front();
+    }
+}
+
+bool InputSystem::Undo() {
+    DropExpiredUndo();
+    if (lockstep_ || undoHistory_.empty()) {
+        return false;
+    }
+    undoHistory_.back().commands.front()->Undo();
+    redoHistory_.push_back(std::move(undoHistory_.back()));
+    undoHistory_.pop_back();
+    return true;
+}
+
+bool InputSystem::Redo() {
+    if (lockstep_ || redoHistory_.empty()) {
+        return false;
+    }
+    auto& commands = redoHistory_.back().commands;
+    commands.front()->Execute();
+    for (size_t i = 1; i < commands.size(); i++) {
+        commands[i]->ExecuteWithoutUndo();
+    }
+    undoHistory_.push_back(std::move(redoHistory_.back()));
+    redoHistory_.pop_back();
+    return true;
 }
 
 void InputSystem::RegisterCommandFactory(Uint32 eventType, CommandFactory factory) {
@@ -142,6 +221,7 @@ void InputSystem::QueueCommand(InputCommandPtr command) {
 void InputSystem::StartRecording() {
     isRecording_ = true;
     recordedCommands_.clear();
+    recordingStartTick_ = CurrentTick();
 }
 
 void InputSystem::StopRecording() {
@@ -155,11 +235,13 @@ void InputSystem::StartPlayback(const std::vector<InputCommandPtr>& commands) {
     playbackCommands_.reserve(commands.size());
     for (const auto& cmd : commands) {
         playbackCommands_.push_back(cmd->Clone());
+        playbackCommands_.back()->SetTick(cmd->GetTick());
     }
     
     isPlayingBack_ = true;
     playbackIndex_ = 0;
     playbackStartTime_ = std::chrono::steady_clock::now();
+    playbackStartTick_ = CurrentTick();
 }
 
 void InputSystem::StopPlayback() {
@@ -215,6 +297,10 @@ void InputSystem::UpdateKeyboardState(const SDL_Event& event) {
     }
 }
 
+uint64_t InputSystem::CurrentTick() const {
+    return world_ ? world_->GetTick() : 0;
+}
+
 void InputSystem::ClearKeyboardTransitions() {
     for (auto& pair : keyboardState_.keysJustPressed) {
         pair.second = false;
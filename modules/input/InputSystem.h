@@ -4,6 +4,7 @@
 #include "InputContextManager.h"
 #include <SDL2/SDL.h>
 #include <queue>
+#include <deque>
 #include <vector>
 #include <functional>
 #include <unordered_map>
@@ -61,6 +62,31 @@ public:
     void StopPlayback();
     bool IsPlayingBack() const { return isPlayingBack_; }
     
+    // In lockstep, playback is indexed by world tick instead of wall-clock
+    // time: a command recorded n ticks into a recording runs exactly n
+    // ticks after playback starts, so a seeded world replays bit for bit.
+    // Playback runs on top of the world as it is, and recordings only live
+    // in memory: saving or loading a command log and resetting the world
+    // to its seeded start before a replay are not implemented, so a
+    // bit-identical replay needs the world reset by the caller.
+    void SetLockstep(bool enabled) { lockstep_ = enabled; }
+    bool IsLockstep() const { return lockstep_; }
+    
+    // Undoable commands that ran are kept, newest last, up to
+    // MAX_UNDO_HISTORY entries; a run of commands sharing an undo group,
+    // such as one brush stroke, is a single entry. Entries whose command
+    // can no longer be undone, such as world commands whose checkpoint the
+    // world dropped to stay within its budget, are discarded. Undo moves the newest
+    // entry back out of the world and onto the redo list, which running
+    // any other undoable command clears. Undo and redo are not commands
+    // and are not recorded, so they are off in lockstep, where nothing
+    // is kept for them, to keep replays identical.
+    static constexpr size_t MAX_UNDO_HISTORY = 64;
+    bool Undo();
+    bool Redo();
+    size_t GetUndoCount() const { return undoHistory_.size(); }
+    size_t GetRedoCount() const { return redoHistory_.size(); }
+    
     void SetWorld(::World* world) { world_ = world; }
     ::World* GetWorld() { return world_; }
     
@@ -75,6 +101,9 @@ private:
     void UpdateMouseState(const SDL_Event& event);
     void UpdateKeyboardState(const SDL_Event& event);
     void ClearKeyboardTransitions();
+    uint64_t CurrentTick() const;
+    void QueueDuePlayback();
+    void DropExpiredUndo();
     
     MouseState mouseState_;
     KeyboardState keyboardState_;
@@ -86,11 +115,21 @@ private:
     
     bool isRecording_ = false;
     std::vector<InputCommandPtr> recordedCommands_;
+    uint64_t recordingStartTick_ = 0;
     
     bool isPlayingBack_ = false;
     std::vector<InputCommandPtr> playbackCommands_;
     size_t playbackIndex_ = 0;
     std::chrono::steady_clock::time_point playbackStartTime_;
+    uint64_t playbackStartTick_ = 0;
+    bool lockstep_ = false;
+    
+    struct UndoEntry {
+        uint64_t group = 0;
+        std::vector<InputCommandPtr> commands; // the first one's Undo covers all
+    };
+    std::deque<UndoEntry> undoHistory_;
+    std::vector<UndoEntry> redoHistory_;
     
     ::World* world_ = nullptr;
     
@@ -6,7 +6,21 @@ enum class MaterialType : uint8_t {
     Air = 0,
     Sand = 1,
     Water = 2,
-    Stone = 3
+    Stone = 3,
+    Steam = 4,
+    Lava = 5,
+    Fire = 6
+};
+
+constexpr int MATERIAL_COUNT = 7;
+
+// Selects the update kernel a material runs each tick. Static materials
+// are filtered out before any kernel is called.
+enum class MaterialBehavior : uint8_t {
+    Static,
+    Powder,
+    Liquid,
+    Gas
 };
 
 struct MaterialProperties {
@@ -14,11 +28,185 @@ struct MaterialProperties {
     bool isLiquid;
     float density;
     uint32_t color;
+    MaterialBehavior behavior;
+};
+
+// Densities are relative to air; gases are lighter than air and rise.
+inline constexpr MaterialProperties MATERIAL_PROPERTIES[] = {
+    {false, false, 0.0f,    0x000000FF, MaterialBehavior::Static},  // Air
+    {true,  false, 2.0f,    0xC2B280FF, MaterialBehavior::Powder},  // Sand
+    {false, true,  1.0f,    0x0080FFFF, MaterialBehavior::Liquid},  // Water
+    {true,  false, 10.0f,   0x808080FF, MaterialBehavior::Static},  // Stone
+    {false, false, -0.5f,   0xE0E0E0FF, MaterialBehavior::Gas},     // Steam
+    {false, true,  3.0f,    0xCF1020FF, MaterialBehavior::Liquid},  // Lava
+    {false, false, -1.0f,   0xFF8020FF, MaterialBehavior::Gas}      // Fire
 };
 
-const MaterialProperties MATERIAL_PROPERTIES[] = {
-    {false, false, 0.0f,    0x000000FF},  // Air
-    {true,  false, 2.0f,    0xC2B280FF},  // Sand
-    {false, true,  1.0f,    0x0080FFFF},  // Water
-    {true,  false, 10.0f,   0x808080FF}   // Stone
-};
\ No newline at end of file
+static_assert(sizeof(MATERIAL_PROPERTIES) / sizeof(MATERIAL_PROPERTIES[0]) == MATERIAL_COUNT,
+              "MATERIAL_PROPERTIES needs one entry per MaterialType");
+
+// DISPLACEMENT_TABLE.canDisplace[a][b] is 1 when a moving cell of material a
+// may swap into a cell of material b: b must be non-solid and lighter.
+// canRise[a][b] is the same for a gas rising: b must be non-solid and
+// denser. Built at compile time so movement rules are single byte loads.
+struct DisplacementTable {
+    uint8_t canDisplace[MATERIAL_COUNT][MATERIAL_COUNT];
+    uint8_t canRise[MATERIAL_COUNT][MATERIAL_COUNT];
+};
+
+constexpr DisplacementTable BuildDisplacementTable() {
+    DisplacementTable table{};
+    for (int a = 0; a < MATERIAL_COUNT; a++) {
+        for (int b = 0; b < MATERIAL_COUNT; b++) {
+            const MaterialProperties& mover = MATERIAL_PROPERTIES[a];
+            const MaterialProperties& target = MATERIAL_PROPERTIES[b];
+            table.canDisplace[a][b] = !target.isSolid && target.density < mover.density;
+            table.canRise[a][b] = !target.isSolid && target.density > mover.density;
+        }
+    }
+    return table;
+}
+
+inline constexpr DisplacementTable DISPLACEMENT_TABLE = BuildDisplacementTable();
+
+constexpr bool CanDisplace(MaterialType mover, MaterialType target) {
+    return DISPLACEMENT_TABLE.canDisplace[static_cast<int>(mover)][static_cast<int>(target)] != 0;
+}
+
+constexpr bool CanRise(MaterialType gas, MaterialType target) {
+    return DISPLACEMENT_TABLE.canRise[static_cast<int>(gas)][static_cast<int>(target)] != 0;
+}
+
+// Heat-driven material changes, sampled from the world's heat field.
+// A transition whose target is the material itself never fires.
+struct PhaseChange {
+    MaterialType hotter;
+    float hotterAbove;
+    MaterialType colder;
+    float colderBelow;
+};
+
+inline constexpr PhaseChange PHASE_CHANGES[] = {
+    {MaterialType::Air,   0.0f,   MaterialType::Air,   0.0f},   // Air
+    {MaterialType::Sand,  0.0f,   MaterialType::Sand,  0.0f},   // Sand
+    {MaterialType::Steam, 100.0f, MaterialType::Water, 0.0f},   // Water
+    {MaterialType::Stone, 0.0f,   MaterialType::Stone, 0.0f},   // Stone
+    {MaterialType::Steam, 0.0f,   MaterialType::Water, 80.0f},  // Steam
+    {MaterialType::Lava,  0.0f,   MaterialType::Lava,  0.0f},   // Lava
+    {MaterialType::Fire,  0.0f,   MaterialType::Fire,  0.0f}    // Fire
+};
+
+static_assert(sizeof(PHASE_CHANGES) / sizeof(PHASE_CHANGES[0]) == MATERIAL_COUNT,
+              "PHASE_CHANGES needs one entry per MaterialType");
+
+constexpr bool HasHotterPhase(MaterialType material) {
+    return PHASE_CHANGES[static_cast<int>(material)].hotter != material;
+}
+
+constexpr bool HasColderPhase(MaterialType material) {
+    return PHASE_CHANGES[static_cast<int>(material)].colder != material;
+}
+
+// Lowest temperature at which any material changes to a hotter phase, so
+// cooler parts of the heat field can be skipped without looking at cells.
+constexpr float LowestHotterPhaseTemperature() {
+    float lowest = 1e30f;
+    for (int m = 0; m < MATERIAL_COUNT; m++) {
+        if (HasHotterPhase(static_cast<MaterialType>(m)) && PHASE_CHANGES[m].hotterAbove < lowest) {
+            lowest = PHASE_CHANGES[m].hotterAbove;
+        }
+    }
+    return lowest;
+}
+
+// Materials with a colder phase, one bit per MaterialType, so chunks whose
+// material counts hold none of them can be skipped when cooling.
+constexpr uint32_t ColderPhaseMaterials() {
+    uint32_t materials = 0;
+    for (int m = 0; m < MATERIAL_COUNT; m++) {
+        if (HasColderPhase(static_cast<MaterialType>(m))) {
+            materials |= 1u << m;
+        }
+    }
+    return materials;
+}
+
+// Timed transitions. A cell with a timer turns into its expired material
+// when the timer runs out. Materials with a lifetime get a timer of
+// lifetime plus up to lifetimeJitter ticks whenever a cell of them is
+// created; World::SetTimer gives any other cell one.
+struct TimedTransition {
+    MaterialType expired;
+    int lifetime;
+    int lifetimeJitter;
+};
+
+inline constexpr TimedTransition TIMED_TRANSITIONS[] = {
+    {MaterialType::Air,   0,  0},   // Air
+    {MaterialType::Air,   0,  0},   // Sand
+    {MaterialType::Air,   0,  0},   // Water
+    {MaterialType::Air,   0,  0},   // Stone
+    {MaterialType::Air,   0,  0},   // Steam
+    {MaterialType::Stone, 0,  0},   // Lava
+    {MaterialType::Air,   30, 30}   // Fire
+};
+
+static_assert(sizeof(TIMED_TRANSITIONS) / sizeof(TIMED_TRANSITIONS[0]) == MATERIAL_COUNT,
+              "TIMED_TRANSITIONS needs one entry per MaterialType");
+
+// Contact reactions: when a cell of material first is next to a cell of
+// material second, with the given chance per tick they become firstBecomes
+// and secondBecomes and release heat into the heat field. Rules apply in
+// either order of the pair.
+struct ReactionRule {
+    MaterialType first;
+    MaterialType second;
+    MaterialType firstBecomes;
+    MaterialType secondBecomes;
+    float probability;
+    float heat;
+};
+
+inline constexpr ReactionRule REACTIONS[] = {
+    {MaterialType::Lava, MaterialType::Water, MaterialType::Stone, MaterialType::Steam, 0.25f, 60.0f},
+    {MaterialType::Fire, MaterialType::Water, MaterialType::Air,   MaterialType::Steam, 0.5f,  10.0f}
+};
+
+// REACTION_TABLE.entries[a][b] is the rule for a cell of a touching a cell
+// of b, from a's side; threshold is the chance scaled to 2^32 and is 0
+// when no rule applies. partners[a] has bit b set for each such b.
+struct ReactionEntry {
+    MaterialType becomes;
+    MaterialType otherBecomes;
+    uint32_t threshold;
+    float heat;
+};
+
+static_assert(MATERIAL_COUNT <= 32, "Reaction partner masks hold one bit per material");
+
+struct ReactionTable {
+    ReactionEntry entries[MATERIAL_COUNT][MATERIAL_COUNT];
+    uint32_t partners[MATERIAL_COUNT];
+};
+
+constexpr uint32_t ReactionThreshold(float probability) {
+    return probability >= 1.0f ? 0xFFFFFFFFu
+         : probability <= 0.0f ? 0u
+         : static_cast<uint32_t>(probability * 4294967296.0f);
+}
+
+constexpr ReactionTable BuildReactionTable() {
+    ReactionTable table{};
+    for (const ReactionRule& rule : REACTIONS) {
+        int a = static_cast<int>(rule.first);
+        int b = static_cast<int>(rule.second);
+        uint32_t threshold = ReactionThreshold(rule.probability);
+        table.entries[a][b] = {rule.firstBecomes, rule.secondBecomes, threshold, rule.heat};
+        table.entries[b][a] = {rule.secondBecomes, rule.firstBecomes, threshold, rule.heat};
+        table.partners[a] |= 1u << b;
+        table.partners[b] |= 1u << a;
+    }
+    return table;
+}
+
+inline constexpr ReactionTable REACTION_TABLE = BuildReactionTable();
@@ -0,0 +1,230 @@
+#include "ScalarField.h"
+#include "../core/ThreadPool.h"
+#include "../core/Random.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Rows per band handed to one thread in Step
+static constexpr int ROWS_PER_BAND = 16;
+
+ScalarField::ScalarField(int width, int height, const FieldParameters& params)
+    : m_width(width)
+    , m_height(height)
+    , m_stride(width + 2)
+    , m_params(params)
+    , m_front(static_cast<size_t>(width + 2) * (height + 2), params.ambient)
+    , m_back(static_cast<size_t>(width + 2) * (height + 2), params.ambient)
+    , m_bandHashes((height + ROWS_PER_BAND - 1) / ROWS_PER_BAND, 0) {
+}
+
+// Keys depend on the ambient value, so every band is rehashed
+void ScalarField::SetParameters(const FieldParameters& params) {
+    m_params = params;
+    Rehash();
+}
+
+float ScalarField::Get(int x, int y) const {
+    if (x < 0 || x >= m_width || y < 0 || y >= m_height) {
+        return m_params.ambient;
+    }
+    return m_front[Index(x, y)];
+}
+
+void ScalarField::Set(int x, int y, float value) {
+    if (x >= 0 && x < m_width && y >= 0 && y < m_height) {
+        float& sample = m_front[Index(x, y)];
+        m_bandHashes[y / ROWS_PER_BAND] ^= SampleKey(x, y, sample) ^ SampleKey(x, y, value);
+        sample = value;
+    }
+}
+
+void ScalarField::Add(int x, int y, float amount) {
+    if (x >= 0 && x < m_width && y >= 0 && y < m_height) {
+        Set(x, y, m_front[Index(x, y)] + amount);
+    }
+}
+
+void ScalarField::Fill(float value) {
+    std::fill(m_front.begin(), m_front.end(), value);
+    Rehash();
+}
+
+void ScalarField::Step(ThreadPool* pool) {
+    UpdateBorder();
+
+    int bands = (m_height + ROWS_PER_BAND - 1) / ROWS_PER_BAND;
+    auto stepBand = [this](int band) {
+        StepRows(band * ROWS_PER_BAND, std::min((band + 1) * ROWS_PER_BAND, m_height));
+    };
+    if (pool) {
+        pool->ParallelFor(bands, stepBand);
+    } else {
+        for (int band = 0; band < bands; band++) {
+            stepBand(band);
+        }
+    }
+
+    m_front.swap(m_back);
+}
+
+void ScalarField::UpdateBorder() {
+    float* data = m_front.data();
+    for (int y = 0; y < m_height; y++) {
+        data[Index(-1, y)] = data[Index(0, y)];
+        data[Index(m_width, y)] = data[Index(m_width - 1, y)];
+    }
+    std::copy_n(&data[Index(-1, 0)], m_stride, &data[Index(-1, -1)]);
+    std::copy_n(&data[Index(-1, m_height - 1)], m_stride, &data[Index(-1, m_height)]);
+}
+
+// new - a = c * (centre - a) + l * (left - a) + r * (right - a)
+//         + u * (up - a) + d * (down - a),
+// with a the ambient value and upwind advection folded into the neighbour
+// weights. Working on differences from ambient keeps a field at rest
+// exactly at ambient instead of drifting by rounding. Samples whose bits
+// change are rekeyed in the band's hash, so a band at rest costs nothing
+// beyond the compare.
+void ScalarField::StepRows(int y0, int y1) {
+    const FieldParameters& p = m_params;
+    float left = p.diffusion + std::max(p.velocityX, 0.0f);
+    float right = p.diffusion + std::max(-p.velocityX, 0.0f);
+    float up = p.diffusion + std::max(p.velocityY, 0.0f);
+    float down = p.diffusion + std::max(-p.velocityY, 0.0f);
+    float centre = 1.0f - left - right - up - down - p.decay;
+    float ambient = p.ambient;
+
+    const float* src = m_front.data();
+    float* dst = m_back.data();
+    uint64_t hash = m_bandHashes[y0 / ROWS_PER_BAND];
+    auto rekey = [&](int x, int y, float before, float after) {
+        uint32_t a;
+        uint32_t b;
+        std::memcpy(&a, &before, sizeof(a));
+        std::memcpy(&b, &after, sizeof(b));
+        if (a != b) {
+            hash ^= SampleKey(x, y, before) ^ SampleKey(x, y, after);
+        }
+    };
+
+    for (int y = y0; y < y1; y++) {
+        int row = Index(0, y);
+        int x = 0;
+#if defined(__SSE2__)
+        __m128 wLeft = _mm_set1_ps(left);
+        __m128 wRight = _mm_set1_ps(right);
+        __m128 wUp = _mm_set1_ps(up);
+        __m128 wDown = _mm_set1_ps(down);
+        __m128 wCentre = _mm_set1_ps(centre);
+        __m128 wAmbient = _mm_set1_ps(ambient);
+        for (; x + 4 <= m_width; x += 4) {
+            const float* s = src + row + x;
+            __m128 sum = _mm_mul_ps(wCentre, _mm_sub_ps(_mm_loadu_ps(s), wAmbient));
+            sum = _mm_add_ps(sum, _mm_mul_ps(wLeft, _mm_sub_ps(_mm_loadu_ps(s - 1), wAmbient)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(wRight, _mm_sub_ps(_mm_loadu_ps(s + 1), wAmbient)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(wUp, _mm_sub_ps(_mm_loadu_ps(s - m_stride), wAmbient)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(wDown, _mm_sub_ps(_mm_loadu_ps(s + m_stride), wAmbient)));
+            __m128 next = _mm_add_ps(wAmbient, sum);
+            _mm_storeu_ps(dst + row + x, next);
+            __m128i same = _mm_cmpeq_epi32(_mm_castps_si128(next), _mm_castps_si128(_mm_loadu_ps(s)));
+            for (int changed = _mm_movemask_ps(_mm_castsi128_ps(same)) ^ 0xF; changed; changed &= changed - 1) {
+                int lane = __builtin_ctz(changed);
+                rekey(x + lane, y, s[lane], dst[row + x + lane]);
+            }
+        }
+#endif
+        for (; x < m_width; x++) {
+            const float* s = src + row + x;
+            dst[row + x] = ambient + (centre * (s[0] - ambient) + left * (s[-1] - ambient) +
+                                      right * (s[1] - ambient) + up * (s[-m_stride] - ambient) +
+                                      down * (s[m_stride] - ambient));
+            rekey(x, y, s[0], dst[row + x]);
+        }
+    }
+    m_bandHashes[y0 / ROWS_PER_BAND] = hash;
+}
+
+FieldSet::FieldSet(int worldWidth, int worldHeight, int cellsPerSample)
+    : m_width((worldWidth + cellsPerSample - 1) / cellsPerSample)
+    , m_height((worldHeight + cellsPerSample - 1) / cellsPerSample)
+    , m_cellsPerSample(cellsPerSample) {
+}
+
+ScalarField& FieldSet::Add(const std::string& name, const FieldParameters& params) {
+    if (ScalarField* existing = Find(name)) {
+        return *existing;
+    }
+    m_fields.emplace_back(name, std::make_unique<ScalarField>(m_width, m_height, params));
+    return *m_fields.back().second;
+}
+
+ScalarField* FieldSet::Find(const std::string& name) {
+    for (auto& field : m_fields) {
+        if (field.first == name) {
+            return field.second.get();
+        }
+    }
+    return nullptr;
+}
+
+const ScalarField* FieldSet::Find(const std::string& name) const {
+    for (const auto& field : m_fields) {
+        if (field.first == name) {
+            return field.second.get();
+        }
+    }
+    return nullptr;
+}
+
+void FieldSet::Step(ThreadPool* pool) {
+    for (auto& field : m_fields) {
+        field.second->Step(pool);
+    }
+}
+
+uint64_t ScalarField::SampleKey(int x, int y, float value) const {
+    if (value == m_params.ambient) {
+        return 0;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return MixBits((static_cast<uint64_t>(y) * m_width + x) << 32 | bits);
+}
+
+void ScalarField::Rehash() {
+    for (int y = 0; y < m_height; y++) {
+        uint64_t& hash = m_bandHashes[y / ROWS_PER_BAND];
+        if (y % ROWS_PER_BAND == 0) {
+            hash = 0;
+        }
+        for (int x = 0; x < m_width; x++) {
+            hash ^= SampleKey(x, y, m_front[Index(x, y)]);
+        }
+    }
+}
+
+uint64_t ScalarField::GetHash() const {
+    uint64_t hash = 0;
+    for (uint64_t band : m_bandHashes) {
+        hash ^= band;
+    }
+    return hash;
+}
+
+uint64_t FieldSet::GetHash() const {
+    uint64_t hash = 0;
+    for (size_t i = 0; i < m_fields.size(); i++) {
+        uint64_t field = m_fields[i].second->GetHash();
+        hash ^= field ? MixBits(field + i) : 0;
+    }
+    return hash;
+}
+
+void FieldSet::Reset() {
+    for (auto& field : m_fields) {
+        field.second->Fill(field.second->GetParameters().ambient);
+    }
+}
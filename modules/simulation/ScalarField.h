@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../core/AlignedAllocator.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+// How a field evolves each tick. The update is a five-point stencil, which
+// stays stable while 4 * diffusion + |velocityX| + |velocityY| + decay <= 1.
+struct FieldParameters {
+    float diffusion = 0.1f;   // fraction exchanged with each neighbour
+    float velocityX = 0.0f;   // advection in samples per tick
+    float velocityY = 0.0f;   // negative moves values up
+    float decay = 0.0f;       // fraction relaxed toward ambient
+    float ambient = 0.0f;
+};
+
+// Scalar quantity (heat, pressure, gas concentration, ...) stored at a lower
+// resolution than the cell grid. Samples are double buffered and surrounded
+// by a one-sample border that mirrors the edge, so the stencil runs without
+// bounds checks and diffusion neither gains nor loses through the edges.
+class ScalarField {
+public:
+    ScalarField(int width, int height, const FieldParameters& params);
+
+    int GetWidth() const { return m_width; }
+    int GetHeight() const { return m_height; }
+    const FieldParameters& GetParameters() const { return m_params; }
+    void SetParameters(const FieldParameters& params);
+
+    // Out-of-range reads return the ambient value; writes are ignored.
+    float Get(int x, int y) const;
+    void Set(int x, int y, float value);
+    void Add(int x, int y, float amount);
+    void Fill(float value);
+
+    // Advances one tick, splitting the rows into bands across the pool.
+    // A field at its ambient value stays exactly there.
+    void Step(ThreadPool* pool);
+
+    // Hash of the samples that differ from ambient; zero for a field at rest.
+    // Each band of rows keeps its own hash, updated only where a write or a
+    // step changes a sample, so reading it costs one word per band.
+    uint64_t GetHash() const;
+
+private:
+    int Index(int x, int y) const { return (y + 1) * m_stride + x + 1; }
+    void UpdateBorder();
+    void StepRows(int y0, int y1);
+    // Hash key of one sample; zero at the ambient value.
+    uint64_t SampleKey(int x, int y, float value) const;
+    void Rehash();
+
+    int m_width;
+    int m_height;
+    int m_stride;
+    FieldParameters m_params;
+    AlignedVector<float> m_front;
+    AlignedVector<float> m_back;
+    std::vector<uint64_t> m_bandHashes;
+};
+
+// Named fields sharing one resolution, each sample covering a square of
+// cellsPerSample x cellsPerSample world cells.
+class FieldSet {
+public:
+    FieldSet(int worldWidth, int worldHeight, int cellsPerSample);
+
+    // Adds a field, or returns the existing field with that name.
+    ScalarField& Add(const std::string& name, const FieldParameters& params);
+    ScalarField* Find(const std::string& name);
+    const ScalarField* Find(const std::string& name) const;
+    size_t GetCount() const { return m_fields.size(); }
+
+    int GetCellsPerSample() const { return m_cellsPerSample; }
+    int GetSampleWidth() const { return m_width; }
+    int GetSampleHeight() const { return m_height; }
+
+    void Step(ThreadPool* pool);
+    // Combined hash of every field; zero while all of them are at rest.
+    uint64_t GetHash() const;
+    // Returns every field to its ambient value.
+    void Reset();
+
+private:
+    int m_width;
+    int m_height;
+    int m_cellsPerSample;
+    // Fields are held by pointer so references stay valid as more are added
+    std::vector<std::pair<std::string, std::unique_ptr<ScalarField>>> m_fields;
+};
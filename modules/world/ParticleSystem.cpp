@@ -0,0 +1,185 @@
+#include "ParticleSystem.h"
+#include "World.h"
+#include <algorithm>
+#include <cmath>
+#include <climits>
+
+ParticleSystem::ParticleSystem(size_t capacity)
+    : m_capacity(capacity) {
+    // Reserved once; push_back and pop_back never reallocate after this
+    m_x.reserve(capacity);
+    m_y.reserve(capacity);
+    m_lastX.reserve(capacity);
+    m_lastY.reserve(capacity);
+    m_velocityX.reserve(capacity);
+    m_velocityY.reserve(capacity);
+    m_material.reserve(capacity);
+}
+
+bool ParticleSystem::Spawn(float x, float y, float velocityX, float velocityY, MaterialType material) {
+    if (m_x.size() >= m_capacity) {
+        return false;
+    }
+
+    m_x.push_back(x);
+    m_y.push_back(y);
+    m_lastX.push_back(x);
+    m_lastY.push_back(y);
+    m_velocityX.push_back(std::clamp(velocityX, -MAX_SPEED, MAX_SPEED));
+    m_velocityY.push_back(std::clamp(velocityY, -MAX_SPEED, MAX_SPEED));
+    m_material.push_back(material);
+    return true;
+}
+
+void ParticleSystem::Update(World& world) {
+    Integrate();
+
+    for (size_t i = 0; i < m_x.size();) {
+        if (Land(i, world)) {
+            Remove(i);
+        } else {
+            i++;
+        }
+    }
+}
+
+void ParticleSystem::Clear() {
+    m_x.clear();
+    m_y.clear();
+    m_lastX.clear();
+    m_lastY.clear();
+    m_velocityX.clear();
+    m_velocityY.clear();
+    m_material.clear();
+}
+
+// std::floor is a library call on plain SSE2 targets
+static int FloorToInt(float value) {
+    int truncated = static_cast<int>(value);
+    return truncated - (value < static_cast<float>(truncated));
+}
+
+void ParticleSystem::Integrate() {
+    float* x = m_x.data();
+    float* y = m_y.data();
+    float* lastX = m_lastX.data();
+    float* lastY = m_lastY.data();
+    const float* velocityX = m_velocityX.data();
+    float* velocityY = m_velocityY.data();
+    size_t count = m_x.size();
+
+    // No branches or calls, so the compiler vectorizes this loop
+    for (size_t i = 0; i < count; i++) {
+        lastX[i] = x[i];
+        lastY[i] = y[i];
+        velocityY[i] = std::min(velocityY[i] + GRAVITY, MAX_SPEED);
+        x[i] += velocityX[i];
+        y[i] += velocityY[i];
+    }
+}
+
+// Looks for air from (x, y) clamped into the world: first straight up the
+// column, then in growing square rings around it, both out to
+// MAX_LANDING_RADIUS. False when there is no air that close.
+static bool FindFreeCell(const World& world, int x, int y, int& freeX, int& freeY) {
+    constexpr int reach = ParticleSystem::MAX_LANDING_RADIUS;
+    x = std::clamp(x, 0, world.GetWidth() - 1);
+    y = std::clamp(y, 0, world.GetHeight() - 1);
+    for (int above = y; above >= std::max(y - reach, 0); above--) {
+        if (world.GetPixel(x, above) == MaterialType::Air) {
+            freeX = x;
+            freeY = above;
+            return true;
+        }
+    }
+
+    for (int radius = 1; radius <= reach; radius++) {
+        for (int dy = -radius; dy <= radius; dy++) {
+            // Inner rows of the ring only have its two side cells
+            int step = (dy == -radius || dy == radius) ? 1 : 2 * radius;
+            for (int dx = -radius; dx <= radius; dx += step) {
+                if (world.GetPixel(x + dx, y + dy) == MaterialType::Air) {
+                    freeX = x + dx;
+                    freeY = y + dy;
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Walks the cells between the particle's last and current position. When
+// one of them blocks it, the particle is written into the last free cell
+// it crossed and true is returned.
+bool ParticleSystem::Land(size_t index, World& world) {
+    float startX = m_lastX[index];
+    float startY = m_lastY[index];
+    float deltaX = m_x[index] - startX;
+    float deltaY = m_y[index] - startY;
+    int steps = -FloorToInt(-std::max(std::fabs(deltaX), std::fabs(deltaY)));
+    float stepSize = steps > 0 ? 1.0f / steps : 0.0f;
+
+    int freeX = 0;
+    int freeY = 0;
+    bool hasFree = false;
+    int cellX = INT_MIN;
+    int cellY = INT_MIN;
+    bool blocked = false;
+
+    for (int step = 0; step <= steps; step++) {
+        float t = step * stepSize;
+        int x = FloorToInt(startX + deltaX * t);
+        int y = FloorToInt(startY + deltaY * t);
+        if (x == cellX && y == cellY) {
+            continue;
+        }
+        cellX = x;
+        cellY = y;
+
+        MaterialType target = world.GetPixel(x, y);
+        if (Blocks(target)) {
+            blocked = true;
+            break;
+        }
+        if (target == MaterialType::Air) {
+            freeX = x;
+            freeY = y;
+            hasFree = true;
+        }
+    }
+    if (!blocked) {
+        return false;
+    }
+
+    if (!hasFree) {
+        // The grid filled the particle's cell while it was in flight, or it
+        // was spawned outside the world; it surfaces in the nearest free
+        // cell, or is dropped if none is near
+        hasFree = FindFreeCell(world, FloorToInt(startX), FloorToInt(startY), freeX, freeY);
+    }
+
+    if (hasFree) {
+        world.SetPixel(freeX, freeY, m_material[index]);
+    }
+    return true;
+}
+
+void ParticleSystem::Remove(size_t index) {
+    size_t last = m_x.size() - 1;
+    m_x[index] = m_x[last];
+    m_y[index] = m_y[last];
+    m_lastX[index] = m_lastX[last];
+    m_lastY[index] = m_lastY[last];
+    m_velocityX[index] = m_velocityX[last];
+    m_velocityY[index] = m_velocityY[last];
+    m_material[index] = m_material[last];
+
+    m_x.pop_back();
+    m_y.pop_back();
+    m_lastX.pop_back();
+    m_lastY.pop_back();
+    m_velocityX.pop_back();
+    m_velocityY.pop_back();
+    m_material.pop_back();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../materials/Materials.h"
+#include "../core/AlignedAllocator.h"
+#include <cstddef>
+
+class World;
+
+// Pixels that have left the grid, e.g. thrown by an explosion or a splash.
+// Particles live in a fixed-capacity struct-of-arrays pool: spawning and
+// landing never allocate. Each tick every particle is integrated in one
+// branch-free loop, then the cells along its path are checked and a
+// particle that hits something is written back into the world as a pixel,
+// in the nearest free cell when its own has been filled. Material is only
+// lost when a particle lands with no air within MAX_LANDING_RADIUS.
+class ParticleSystem {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 17;
+    // Cells per tick squared; matches the grid's free-fall acceleration.
+    static constexpr float GRAVITY = 0.25f;
+    // Cells per tick along each axis, so the path walk stays bounded.
+    static constexpr float MAX_SPEED = 32.0f;
+    // How far, in cells, a particle whose own cell is filled looks for a
+    // free one before it is dropped; two chunks, so landing in a nearly
+    // full world costs at most a few tens of thousands of reads.
+    static constexpr int MAX_LANDING_RADIUS = 128;
+
+    explicit ParticleSystem(size_t capacity = DEFAULT_CAPACITY);
+
+    // Returns false when the pool is full.
+    bool Spawn(float x, float y, float velocityX, float velocityY, MaterialType material);
+    void Update(World& world);
+    void Clear();
+
+    size_t GetCount() const { return m_x.size(); }
+    size_t GetCapacity() const { return m_capacity; }
+    float GetX(size_t index) const { return m_x[index]; }
+    float GetY(size_t index) const { return m_y[index]; }
+    MaterialType GetMaterial(size_t index) const { return m_material[index]; }
+
+    // Whether a flying particle stops before entering a cell of the target
+    // material: anything solid or liquid catches it.
+    static bool Blocks(MaterialType target) {
+        const MaterialProperties& props = MATERIAL_PROPERTIES[static_cast<int>(target)];
+        return props.isSolid || props.isLiquid;
+    }
+
+private:
+    void Integrate();
+    bool Land(size_t index, World& world);
+    void Remove(size_t index);
+
+    size_t m_capacity;
+    AlignedVector<float> m_x;
+    AlignedVector<float> m_y;
+    AlignedVector<float> m_lastX;
+    AlignedVector<float> m_lastY;
+    AlignedVector<float> m_velocityX;
+    AlignedVector<float> m_velocityY;
+    AlignedVector<MaterialType> m_material;
+};
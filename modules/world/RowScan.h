@@ -0,0 +1,147 @@
+#pragma once
+
+#include "../materials/Materials.h"
+#include <cstdint>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <immintrin.h>
+#define FUNHOUSE_ROWSCAN_X86 1
+#endif
+
+// Vectorized pre-pass for the update loop: classifies a run of up to 64
+// cells at once so the scalar kernels only run on cells that can move.
+
+struct StaticMaterialList {
+    uint8_t ids[MATERIAL_COUNT];
+    int count;
+};
+
+constexpr StaticMaterialList BuildStaticMaterialList() {
+    StaticMaterialList list{};
+    for (int m = 0; m < MATERIAL_COUNT; m++) {
+        if (MATERIAL_PROPERTIES[m].behavior == MaterialBehavior::Static) {
+            list.ids[list.count++] = static_cast<uint8_t>(m);
+        }
+    }
+    return list;
+}
+
+inline constexpr StaticMaterialList STATIC_MATERIALS = BuildStaticMaterialList();
+
+inline uint64_t MovableMaskScalar(const MaterialType* cells, int begin, int count) {
+    uint64_t mask = 0;
+    for (int i = begin; i < count; i++) {
+        if (MATERIAL_PROPERTIES[static_cast<int>(cells[i])].behavior != MaterialBehavior::Static) {
+            mask |= 1ull << i;
+        }
+    }
+    return mask;
+}
+
+#ifdef FUNHOUSE_ROWSCAN_X86
+
+__attribute__((target("avx2")))
+inline uint64_t MovableMaskAvx2(const MaterialType* cells, int count) {
+    uint64_t mask = 0;
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i));
+        __m256i isStatic = _mm256_setzero_si256();
+        for (int s = 0; s < STATIC_MATERIALS.count; s++) {
+            __m256i id = _mm256_set1_epi8(static_cast<char>(STATIC_MATERIALS.ids[s]));
+            isStatic = _mm256_or_si256(isStatic, _mm256_cmpeq_epi8(v, id));
+        }
+        uint32_t bits = ~static_cast<uint32_t>(_mm256_movemask_epi8(isStatic));
+        mask |= static_cast<uint64_t>(bits) << i;
+    }
+    return mask | MovableMaskScalar(cells, i, count);
+}
+
+inline uint64_t MovableMaskSse2(const MaterialType* cells, int count) {
+    uint64_t mask = 0;
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i));
+        __m128i isStatic = _mm_setzero_si128();
+        for (int s = 0; s < STATIC_MATERIALS.count; s++) {
+            __m128i id = _mm_set1_epi8(static_cast<char>(STATIC_MATERIALS.ids[s]));
+            isStatic = _mm_or_si128(isStatic, _mm_cmpeq_epi8(v, id));
+        }
+        uint32_t bits = ~static_cast<uint32_t>(_mm_movemask_epi8(isStatic)) & 0xFFFFu;
+        mask |= static_cast<uint64_t>(bits) << i;
+    }
+    return mask | MovableMaskScalar(cells, i, count);
+}
+
+#endif
+
+inline uint64_t MaterialSetMaskScalar(const MaterialType* cells, int begin, int count, uint32_t materials) {
+    uint64_t mask = 0;
+    for (int i = begin; i < count; i++) {
+        if ((materials >> static_cast<int>(cells[i])) & 1) {
+            mask |= 1ull << i;
+        }
+    }
+    return mask;
+}
+
+#ifdef FUNHOUSE_ROWSCAN_X86
+
+__attribute__((target("avx2")))
+inline uint64_t MaterialSetMaskAvx2(const MaterialType* cells, int count, uint32_t materials) {
+    uint64_t mask = 0;
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i));
+        __m256i match = _mm256_setzero_si256();
+        for (uint32_t set = materials; set; set &= set - 1) {
+            __m256i id = _mm256_set1_epi8(static_cast<char>(__builtin_ctz(set)));
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi8(v, id));
+        }
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(match))) << i;
+    }
+    return mask | MaterialSetMaskScalar(cells, i, count, materials);
+}
+
+inline uint64_t MaterialSetMaskSse2(const MaterialType* cells, int count, uint32_t materials) {
+    uint64_t mask = 0;
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i));
+        __m128i match = _mm_setzero_si128();
+        for (uint32_t set = materials; set; set &= set - 1) {
+            __m128i id = _mm_set1_epi8(static_cast<char>(__builtin_ctz(set)));
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(v, id));
+        }
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(match))) << i;
+    }
+    return mask | MaterialSetMaskScalar(cells, i, count, materials);
+}
+
+#endif
+
+// Returns a mask with bit i set when bit cells[i] of materials is set.
+// count must be at most 64; no bytes past cells[count - 1] are read.
+inline uint64_t MaterialSetMask(const MaterialType* cells, int count, uint32_t materials) {
+#ifdef FUNHOUSE_ROWSCAN_X86
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2 ? MaterialSetMaskAvx2(cells, count, materials) : MaterialSetMaskSse2(cells, count, materials);
+#else
+    return MaterialSetMaskScalar(cells, 0, count, materials);
+#endif
+}
+
+// Returns a mask with bit i set when cells[i] has a non-static behavior.
+// count must be at most 64; no bytes past cells[count - 1] are read.
+inline uint64_t MovableMask(const MaterialType* cells, int count) {
+#ifdef FUNHOUSE_ROWSCAN_X86
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2 ? MovableMaskAvx2(cells, count) : MovableMaskSse2(cells, count);
+#else
+    return MovableMaskScalar(cells, 0, count);
+#endif
+}
+
+// Bit iteration helpers for walking a mask in either scan direction.
+inline int LowestBit(uint64_t mask) { return __builtin_ctzll(mask); }
+inline int HighestBit(uint64_t mask) { return 63 - __builtin_clzll(mask); }
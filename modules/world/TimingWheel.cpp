@@ -0,0 +1,65 @@
+#include "TimingWheel.h"
+
+TimingWheel::TimingWheel(uint64_t now)
+    : m_slots(LEVELS * SLOTS)
+    , m_current(now)
+    , m_pending(0) {
+}
+
+void TimingWheel::Schedule(uint64_t tick, int64_t id) {
+    Place({tick > m_current ? tick : m_current + 1, id});
+    m_pending++;
+}
+
+// An event goes on the lowest level whose current turn contains its tick,
+// in the slot of its tick at that level's resolution.
+void TimingWheel::Place(const Event& event) {
+    for (int level = 0; level < LEVELS; level++) {
+        int shift = SLOT_BITS * (level + 1);
+        if ((event.tick >> shift) == (m_current >> shift)) {
+            Slot(level, (event.tick >> (SLOT_BITS * level)) & (SLOTS - 1)).push_back(event);
+            return;
+        }
+    }
+    m_overflow.push_back(event);
+}
+
+void TimingWheel::Cascade(std::vector<Event>& slot) {
+    m_cascading.swap(slot);
+    for (const Event& event : m_cascading) {
+        Place(event);
+    }
+    m_cascading.clear();
+}
+
+void TimingWheel::Advance(uint64_t now, std::vector<Event>& due) {
+    while (m_current < now) {
+        m_current++;
+
+        // Higher levels first, so their events reach level 0 before it is read
+        constexpr int HORIZON_BITS = SLOT_BITS * LEVELS;
+        if ((m_current & ((1ull << HORIZON_BITS) - 1)) == 0) {
+            Cascade(m_overflow);
+        }
+        for (int level = LEVELS - 1; level > 0; level--) {
+            int shift = SLOT_BITS * level;
+            if ((m_current & ((1ull << shift) - 1)) == 0) {
+                Cascade(Slot(level, (m_current >> shift) & (SLOTS - 1)));
+            }
+        }
+
+        std::vector<Event>& slot = Slot(0, m_current & (SLOTS - 1));
+        due.insert(due.end(), slot.begin(), slot.end());
+        m_pending -= slot.size();
+        slot.clear();
+    }
+}
+
+void TimingWheel::Reset(uint64_t now) {
+    for (std::vector<Event>& slot : m_slots) {
+        slot.clear();
+    }
+    m_overflow.clear();
+    m_current = now;
+    m_pending = 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Hierarchical timing wheel for events due at a future tick. Level 0 has
+// one slot per tick; each higher level has one slot per full turn of the
+// level below, and its events cascade down when the wheel reaches their
+// slot. Scheduling is O(1) and advancing one tick costs only the events
+// that are due or cascading, however many are pending.
+class TimingWheel {
+public:
+    struct Event {
+        uint64_t tick;
+        int64_t id;
+    };
+
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr int LEVELS = 4;
+
+    explicit TimingWheel(uint64_t now = 0);
+
+    // Events at or before the current tick are due on the next one.
+    void Schedule(uint64_t tick, int64_t id);
+    // Moves the wheel to tick now, appending every event that came due.
+    void Advance(uint64_t now, std::vector<Event>& due);
+    // Drops every pending event and restarts the wheel at tick now.
+    void Reset(uint64_t now);
+
+    uint64_t GetCurrentTick() const { return m_current; }
+    size_t GetPendingCount() const { return m_pending; }
+
+private:
+    void Place(const Event& event);
+    void Cascade(std::vector<Event>& slot);
+    std::vector<Event>& Slot(int level, int slot) { return m_slots[level * SLOTS + slot]; }
+
+    std::vector<std::vector<Event>> m_slots;
+    std::vector<Event> m_overflow;  // beyond the top level's horizon
+    std::vector<Event> m_cascading; // scratch for Cascade
+    uint64_t m_current;
+    size_t m_pending;
+};
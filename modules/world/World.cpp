@@ -1,45 +1,1869 @@
 #include "World.h"
+#include "../core/ThreadPool.h"
+#include "../core/Random.h"
+#include "RowScan.h"
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <functional>
+#include <utility>
+#include <iterator>
+#include <unordered_set>
+#include <cstring>
 
-World::World(int width, int height)
+World::World(int width, int height, WorldStorage storage)
     : m_width(width)
     , m_height(height)
-    , m_pixels(width * height, MaterialType::Air)
-    , m_updateDirection(false) {
+    , m_stride(width + 2)
+    , m_chunksX((width + CHUNK_SIZE - 1) / CHUNK_SIZE)
+    , m_chunksY((height + CHUNK_SIZE - 1) / CHUNK_SIZE)
+    , m_sparse(storage == WorldStorage::Sparse)
+    , m_bitPlanes(false)
+    , m_threadPool(std::make_unique<ThreadPool>(1))
+    , m_fields(m_sparse ? 0 : width, m_sparse ? 0 : height, FIELD_CELL_SIZE)
+    , m_heat(nullptr)
+    , m_timersDue(0)
+    , m_updateDirection(false)
+    , m_cellsScanned(0)
+    , m_cellsUpdated(0)
+    , m_cellsReactionChecked(0)
+    , m_chunksDeferred(0)
+    , m_changeStamp(1)
+    , m_releaseStamp(0)
+    , m_stateHash(0)
+    , m_laneHashStamp(0)
+    , m_newestCheckpoint(0)
+    , m_checkpointBytes(0)
+    , m_checkpointBudget(DEFAULT_CHECKPOINT_BUDGET)
+    , m_lastCheckpointId(0)
+    , m_focusMargin(DEFAULT_FOCUS_MARGIN)
+    , m_distantInterval(DEFAULT_DISTANT_INTERVAL)
+    , m_seed(0)
+    , m_tick(0)
+    , m_tickRandomKey(TickRandomKey(0, 0))
+    , m_levelingInterval(DEFAULT_LEVELING_INTERVAL)
+    , m_circleRadius(-1) {
+    if (m_sparse) {
+        // Only the block every unallocated chunk reads from
+        ResizeStorage(CHUNK_CELLS);
+        m_chunkBlocks.assign(1, 0);
+        m_blockChunks.assign(1, -1);
+    } else {
+        ResizeStorage(static_cast<size_t>(m_stride) * (height + 2));
+        FillBorder();
+        m_chunks.resize(static_cast<size_t>(m_chunksX) * m_chunksY);
+        for (int cy = 0; cy < m_chunksY; cy++) {
+            for (int cx = 0; cx < m_chunksX; cx++) {
+                m_chunks[cy * m_chunksX + cx].chunkX = cx;
+                m_chunks[cy * m_chunksX + cx].chunkY = cy;
+            }
+        }
+    }
+
+    if (!m_sparse) {
+        // Heat spreads, rises slowly and relaxes back to ambient
+        FieldParameters heat;
+        heat.diffusion = 0.15f;
+        heat.velocityY = -0.1f;
+        heat.decay = 0.01f;
+        heat.ambient = AMBIENT_TEMPERATURE;
+        m_heat = &m_fields.Add(HEAT_FIELD, heat);
+    }
+
+    ResetMaterialCounts();
+}
+
+World::~World() = default;
+
+void World::SetThreadCount(int threadCount) {
+    if (threadCount != m_threadPool->GetThreadCount()) {
+        m_threadPool = std::make_unique<ThreadPool>(threadCount);
+    }
+}
+
+int World::GetThreadCount() const {
+    return m_threadPool->GetThreadCount();
+}
+
+void World::SetSeed(uint64_t seed) {
+    m_seed = seed;
+    m_tickRandomKey = TickRandomKey(m_seed, m_tick);
+}
+
+void World::SetVelocity(int x, int y, int velocityX, int velocityY) {
+    if (InBounds(x, y)) {
+        size_t index = WritableIndex(x, y);
+        m_velocityX[index] = static_cast<int8_t>(velocityX);
+        m_velocityY[index] = static_cast<int8_t>(velocityY);
+        StampChunk(ChunkIndex(x, y));
+    }
+}
+
+int World::GetVelocityX(int x, int y) const {
+    return InBounds(x, y) ? m_velocityX[Index(x, y)] : 0;
+}
+
+int World::GetVelocityY(int x, int y) const {
+    return InBounds(x, y) ? m_velocityY[Index(x, y)] : 0;
+}
+
+void World::SetTimer(int x, int y, int ticks) {
+    if (!InBounds(x, y)) {
+        return;
+    }
+    WritableIndex(x, y);
+    PreserveChunk(ChunkIndex(x, y));
+    StampChunk(ChunkIndex(x, y));
+    if (ticks > 0) {
+        StartTimer(x, y, std::min(ticks, MAX_TIMER_TICKS));
+    } else {
+        m_flags[Index(x, y)] &= ~CELL_TIMED;
+    }
+}
+
+int World::GetTimer(int x, int y) const {
+    if (!InBounds(x, y) || !(m_flags[Index(x, y)] & CELL_TIMED)) {
+        return 0;
+    }
+    return static_cast<uint16_t>(m_timerTick[Index(x, y)] - static_cast<uint16_t>(m_tick));
+}
+
+// May run inside the parallel passes, e.g. when a reaction creates a timed
+// material, so the shared wheel is locked.
+void World::StartTimer(int x, int y, int ticks) {
+    uint64_t tick = m_tick + ticks;
+    size_t index = Index(x, y);
+    m_flags[index] |= CELL_TIMED;
+    m_timerTick[index] = static_cast<uint16_t>(tick);
+    std::lock_guard<std::mutex> lock(m_timersLock);
+    m_timers.Schedule(tick, CellId(x, y));
+}
+
+void World::ExpireTimers() {
+    m_dueTimers.clear();
+    m_timers.Advance(m_tick, m_dueTimers);
+    m_timersDue = m_dueTimers.size();
+
+    for (const TimingWheel::Event& event : m_dueTimers) {
+        int x = static_cast<int>(event.id % m_width);
+        int y = static_cast<int>(event.id / m_width);
+        // A released sparse chunk reads as untimed air
+        size_t index = Index(x, y);
+        if (!(m_flags[index] & CELL_TIMED) || m_timerTick[index] != static_cast<uint16_t>(event.tick)) {
+            continue;
+        }
+        MaterialType expired = TIMED_TRANSITIONS[static_cast<int>(m_pixels[index])].expired;
+        PreserveChunk(ChunkIndex(x, y));
+        m_flags[index] &= ~CELL_TIMED;
+        SetPixel(x, y, expired);
+    }
+}
+
+// Byte i of the result is all ones when bit i of the low eight bits is set.
+static uint64_t ByteMask(uint64_t bits) {
+    uint64_t mask = ((bits & 0xFF) * 0x0101010101010101ull) & 0x8040201008040201ull;
+    mask = ((mask + 0x7F7F7F7F7F7F7F7Full) | mask) & 0x8080808080808080ull;
+    return (mask >> 7) * 0xFF;
+}
+
+// Swaps a[i] and b[i] for every bit i set in columns, eight bytes of each
+// row at a time. Words reaching past count would touch cells beyond the
+// chunk, which another thread may own, so those elements swap one by one.
+template <typename T>
+static void SwapMasked(T* a, T* b, uint64_t columns, int count) {
+    static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Element k of a word is its k-th lowest bytes");
+    constexpr int perWord = static_cast<int>(sizeof(uint64_t) / sizeof(T));
+    constexpr uint64_t group = (1ull << perWord) - 1;
+    while (columns) {
+        int first = LowestBit(columns) / perWord * perWord;
+        uint64_t bits = (columns >> first) & group;
+        columns &= ~(group << first);
+        if (first + perWord > count) {
+            for (; bits; bits &= bits - 1) {
+                std::swap(a[first + LowestBit(bits)], b[first + LowestBit(bits)]);
+            }
+            continue;
+        }
+
+        uint64_t bytes = 0;
+        for (int k = 0; k < perWord; k++) {
+            bytes |= ((bits >> k) & 1) * ((1ull << sizeof(T)) - 1) << (k * sizeof(T));
+        }
+        uint64_t wordA;
+        uint64_t wordB;
+        std::memcpy(&wordA, a + first, sizeof(wordA));
+        std::memcpy(&wordB, b + first, sizeof(wordB));
+        uint64_t differs = (wordA ^ wordB) & ByteMask(bytes);
+        wordA ^= differs;
+        wordB ^= differs;
+        std::memcpy(a + first, &wordA, sizeof(wordA));
+        std::memcpy(b + first, &wordB, sizeof(wordB));
+    }
+}
+
+void World::SwapLanes(size_t from, size_t to, uint64_t columns, int count) {
+    SwapMasked(&m_velocityX[from], &m_velocityX[to], columns, count);
+    SwapMasked(&m_velocityY[from], &m_velocityY[to], columns, count);
+    SwapMasked(&m_timerTick[from], &m_timerTick[to], columns, count);
+}
+
+void World::SwapLanes(size_t from, size_t to) {
+    std::swap(m_velocityX[from], m_velocityX[to]);
+    std::swap(m_velocityY[from], m_velocityY[to]);
+    std::swap(m_timerTick[from], m_timerTick[to]);
+}
+
+// Also clears the cells' flags.
+void World::ResetLanes(size_t index, int count) {
+    std::memset(&m_flags[index], 0, count);
+    std::memset(&m_velocityX[index], 0, count);
+    std::memset(&m_velocityY[index], 0, count);
+    std::fill_n(&m_timerTick[index], count, 0);
+}
+
+void World::ResetLanes(size_t index) {
+    m_velocityX[index] = 0;
+    m_velocityY[index] = 0;
+    m_timerTick[index] = 0;
+}
+
+void World::ResizeStorage(size_t cells) {
+    m_pixels.resize(cells, MaterialType::Air);
+    m_flags.resize(cells, 0);
+    m_velocityX.resize(cells, 0);
+    m_velocityY.resize(cells, 0);
+    m_timerTick.resize(cells, 0);
+}
+
+int World::FindChunk(int chunkX, int chunkY) const {
+    if (chunkX < 0 || chunkX >= m_chunksX || chunkY < 0 || chunkY >= m_chunksY) {
+        return -1;
+    }
+    if (!m_sparse) {
+        return chunkY * m_chunksX + chunkX;
+    }
+    auto it = m_chunkSlots.find(ChunkKey(chunkX, chunkY));
+    return it != m_chunkSlots.end() ? it->second : -1;
+}
+
+void World::CellPosition(size_t index, int& x, int& y) const {
+    if (!m_sparse) {
+        x = index % m_stride - 1;
+        y = index / m_stride - 1;
+        return;
+    }
+    const Chunk& chunk = m_chunks[m_blockChunks[index / CHUNK_CELLS]];
+    int local = index % CHUNK_CELLS;
+    x = chunk.chunkX * CHUNK_SIZE + local % CHUNK_SIZE;
+    y = chunk.chunkY * CHUNK_SIZE + local / CHUNK_SIZE;
+}
+
+// The ring is never written after this, since every write is bounds
+// checked and the kernels only move into non-solid cells.
+void World::FillBorder() {
+    int last = m_height + 1;
+    std::fill_n(&m_pixels[0], m_stride, MaterialType::Stone);
+    std::fill_n(&m_pixels[static_cast<size_t>(last) * m_stride], m_stride, MaterialType::Stone);
+    for (int y = 1; y < last; y++) {
+        m_pixels[static_cast<size_t>(y) * m_stride] = MaterialType::Stone;
+        m_pixels[static_cast<size_t>(y) * m_stride + m_stride - 1] = MaterialType::Stone;
+    }
+}
+
+size_t World::WritableIndex(int x, int y) {
+    if (m_sparse) {
+        EnsureChunk(x / CHUNK_SIZE, y / CHUNK_SIZE);
+    }
+    return Index(x, y);
+}
+
+int World::EnsureChunk(int chunkX, int chunkY) {
+    int chunk = FindChunk(chunkX, chunkY);
+    if (chunk >= 0 || !m_sparse || chunkX < 0 || chunkX >= m_chunksX || chunkY < 0 || chunkY >= m_chunksY) {
+        return chunk;
+    }
+
+    chunk = static_cast<int>(m_chunks.size());
+    m_chunks.emplace_back();
+    m_chunks.back().chunkX = chunkX;
+    m_chunks.back().chunkY = chunkY;
+    m_chunks.back().materialCounts[static_cast<int>(MaterialType::Air)].value.store(
+        ChunkCellCount(chunkX, chunkY), std::memory_order_relaxed);
+    m_chunkSlots.emplace(ChunkKey(chunkX, chunkY), chunk);
+
+    size_t block = m_blockChunks.size();
+    if (!m_freeBlocks.empty()) {
+        block = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+    } else {
+        m_blockChunks.push_back(-1);
+        size_t blocks = m_pixels.size() / CHUNK_CELLS;
+        if (block >= blocks) {
+            ResizeStorage(2 * blocks * CHUNK_CELLS);
+        }
+    }
+    m_chunkBlocks.push_back(block);
+    m_blockChunks[block] = chunk;
+    return chunk;
+}
+
+// Cells move at most CHUNK_SIZE / 2 per tick, so the passes only write to
+// awake chunks and their direct neighbours. Allocating those first means
+// the chunk map never changes while the passes run.
+void World::AllocateNeighbourChunks() {
+    size_t count = m_chunks.size();
+    for (size_t i = 0; i < count; i++) {
+        if (m_chunks[i].rect.IsEmpty()) {
+            continue;
+        }
+        int chunkX = m_chunks[i].chunkX;
+        int chunkY = m_chunks[i].chunkY;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                EnsureChunk(chunkX + dx, chunkY + dy);
+            }
+        }
+    }
+}
+
+// A chunk is released once it is all air and neither it nor a neighbour is
+// awake, so chunks at the edge of activity are not released and allocated
+// again every tick.
+void World::ReleaseEmptyChunks() {
+    for (int i = static_cast<int>(m_chunks.size()) - 1; i >= 0; i--) {
+        const Chunk& chunk = m_chunks[i];
+        int air = chunk.materialCounts[static_cast<int>(MaterialType::Air)].value.load(std::memory_order_relaxed);
+        if (air != ChunkCellCount(chunk.chunkX, chunk.chunkY)) {
+            continue;
+        }
+
+        bool awake = false;
+        for (int dy = -1; dy <= 1 && !awake; dy++) {
+            for (int dx = -1; dx <= 1 && !awake; dx++) {
+                awake = IsChunkAwake(chunk.chunkX + dx, chunk.chunkY + dy);
+            }
+        }
+        if (!awake) {
+            RemoveChunk(i);
+        }
+    }
+    CompactBlocks();
+}
+
+// Blocks in use past the first m_chunks.size() blocks move into the
+// released blocks below that point, lowest first, so the blocks in use
+// end up packed at the front and the tail can be freed.
+void World::CompactBlocks() {
+    size_t live = m_chunks.size();
+    size_t capacity = m_pixels.size() / CHUNK_CELLS - 1;
+    if (capacity <= MIN_COMPACT_BLOCKS || capacity <= COMPACT_RATIO * live) {
+        return;
+    }
+
+    std::sort(m_freeBlocks.begin(), m_freeBlocks.end());
+    size_t next = 0;
+    for (size_t block = live + 1; block < m_blockChunks.size(); block++) {
+        int chunk = m_blockChunks[block];
+        if (chunk < 0) {
+            continue;
+        }
+        size_t target = m_freeBlocks[next++];
+        size_t from = block * CHUNK_CELLS;
+        size_t to = target * CHUNK_CELLS;
+        std::copy_n(&m_pixels[from], CHUNK_CELLS, &m_pixels[to]);
+        std::copy_n(&m_flags[from], CHUNK_CELLS, &m_flags[to]);
+        std::copy_n(&m_velocityX[from], CHUNK_CELLS, &m_velocityX[to]);
+        std::copy_n(&m_velocityY[from], CHUNK_CELLS, &m_velocityY[to]);
+        std::copy_n(&m_timerTick[from], CHUNK_CELLS, &m_timerTick[to]);
+        m_chunkBlocks[chunk + 1] = target;
+        m_blockChunks[target] = chunk;
+    }
+
+    m_blockChunks.resize(live + 1);
+    m_freeBlocks.clear();
+    ResizeStorage((live + 1) * CHUNK_CELLS);
+    m_pixels.shrink_to_fit();
+    m_flags.shrink_to_fit();
+    m_velocityX.shrink_to_fit();
+    m_velocityY.shrink_to_fit();
+    m_timerTick.shrink_to_fit();
+}
+
+size_t World::GetStorageBytes() const {
+    return m_pixels.capacity() * sizeof(MaterialType) + m_flags.capacity() + m_velocityX.capacity() +
+           m_velocityY.capacity() + m_timerTick.capacity() * sizeof(uint16_t);
+}
+
+// The last chunk moves into the removed chunk's place and keeps its block,
+// so storage indices stay valid. The released block is reset, ready for
+// the next allocation to take it without touching the rest of storage.
+void World::RemoveChunk(int chunk) {
+    int last = static_cast<int>(m_chunks.size()) - 1;
+    size_t block = m_chunkBlocks[chunk + 1];
+    m_chunkSlots.erase(ChunkKey(m_chunks[chunk].chunkX, m_chunks[chunk].chunkY));
+    m_releaseStamp = m_changeStamp;
+    if (chunk != last) {
+        m_chunks[chunk] = std::move(m_chunks[last]);
+        m_chunkBlocks[chunk + 1] = m_chunkBlocks[last + 1];
+        m_blockChunks[m_chunkBlocks[chunk + 1]] = chunk;
+        m_chunkSlots[ChunkKey(m_chunks[chunk].chunkX, m_chunks[chunk].chunkY)] = chunk;
+    }
+    m_chunks.pop_back();
+    m_chunkBlocks.pop_back();
+    ResetBlock(block);
+    m_blockChunks[block] = -1;
+    m_freeBlocks.push_back(block);
+}
+
+void World::ResetBlock(size_t block) {
+    size_t first = block * CHUNK_CELLS;
+    std::fill_n(&m_pixels[first], CHUNK_CELLS, MaterialType::Air);
+    ResetLanes(first, CHUNK_CELLS);
+}
+
+void World::SetPowderBitPlanes(bool enabled) {
+    static_assert(CHUNK_SIZE == 64, "Bit plane words hold exactly one chunk row");
+
+    // The planes are laid out over dense storage
+    m_bitPlanes = enabled && !m_sparse;
+    if (m_bitPlanes) {
+        m_emptyBits = std::vector<std::atomic<uint64_t>>(static_cast<size_t>(m_height) * m_chunksX);
+        m_powderBits = std::vector<std::atomic<uint64_t>>(static_cast<size_t>(m_height) * m_chunksX);
+        RebuildBitPlanes();
+    } else {
+        m_emptyBits.clear();
+        m_powderBits.clear();
+    }
+}
+
+void World::RebuildBitPlanes() {
+    for (size_t i = 0; i < m_emptyBits.size(); i++) {
+        m_emptyBits[i].store(0, std::memory_order_relaxed);
+        m_powderBits[i].store(0, std::memory_order_relaxed);
+    }
+    for (int y = 0; y < m_height; y++) {
+        for (int x = 0; x < m_width; x++) {
+            SyncBitPlanes(x, y);
+        }
+    }
+}
+
+void World::SyncBitPlanes(int x, int y) {
+    MaterialType material = m_pixels[Index(x, y)];
+    uint64_t bit = 1ull << (x % CHUNK_SIZE);
+    size_t word = PlaneWord(x, y);
+
+    if (material == MaterialType::Air) {
+        m_emptyBits[word].fetch_or(bit, std::memory_order_relaxed);
+    } else {
+        m_emptyBits[word].fetch_and(~bit, std::memory_order_relaxed);
+    }
+    if (MATERIAL_PROPERTIES[static_cast<int>(material)].behavior == MaterialBehavior::Powder) {
+        m_powderBits[word].fetch_or(bit, std::memory_order_relaxed);
+    } else {
+        m_powderBits[word].fetch_and(~bit, std::memory_order_relaxed);
+    }
+}
+
+void World::DirtyRect::Include(int x0, int y0, int x1, int y1) {
+    minX = std::min(minX, x0);
+    minY = std::min(minY, y0);
+    maxX = std::max(maxX, x1);
+    maxY = std::max(maxY, y1);
+}
+
+void World::DirtyRect::Include(const DirtyRect& other) {
+    if (!other.IsEmpty()) {
+        Include(other.minX, other.minY, other.maxX, other.maxY);
+    }
+}
+
+static void AtomicMin(std::atomic<int>& value, int candidate) {
+    int current = value.load(std::memory_order_relaxed);
+    while (candidate < current &&
+           !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+    }
+}
+
+static void AtomicMax(std::atomic<int>& value, int candidate) {
+    int current = value.load(std::memory_order_relaxed);
+    while (candidate > current &&
+           !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+    }
+}
+
+void World::AtomicDirtyRect::Include(int x0, int y0, int x1, int y1) {
+    AtomicMin(minX, x0);
+    AtomicMin(minY, y0);
+    AtomicMax(maxX, x1);
+    AtomicMax(maxY, y1);
+}
+
+World::AtomicDirtyRect& World::AtomicDirtyRect::operator=(const AtomicDirtyRect& other) {
+    minX.store(other.minX.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    minY.store(other.minY.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    maxX.store(other.maxX.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    maxY.store(other.maxY.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+}
+
+World::DirtyRect World::AtomicDirtyRect::Take() {
+    DirtyRect rect;
+    rect.minX = minX.exchange(INT_MAX, std::memory_order_relaxed);
+    rect.minY = minY.exchange(INT_MAX, std::memory_order_relaxed);
+    rect.maxX = maxX.exchange(INT_MIN, std::memory_order_relaxed);
+    rect.maxY = maxY.exchange(INT_MIN, std::memory_order_relaxed);
+    return rect;
+}
+
+void World::Update() {
+    m_changeStamp++;
+    m_updateDirection = !m_updateDirection;
+    m_cellsScanned = 0;
+    m_tick++;
+    m_tickRandomKey = TickRandomKey(m_seed, m_tick);
+
+    m_chunksDeferred = 0;
+    for (Chunk& chunk : m_chunks) {
+        // Skipped chunks keep their changes for the tick they next run on
+        if (!m_focusRects.empty()) {
+            chunk.interval = GetChunkUpdateInterval(chunk.chunkX, chunk.chunkY);
+            if (!IsChunkDue(chunk)) {
+                chunk.rect = DirtyRect();
+                if (!chunk.changed.IsEmpty() || !chunk.lastChanged.IsEmpty()) {
+                    chunk.backlog = std::min(chunk.backlog + 1, MAX_CATCH_UP_TICKS);
+                    m_chunksDeferred++;
+                }
+                continue;
+            }
+        } else {
+            chunk.interval = 1;
+        }
+        TakeChunkRect(chunk);
+    }
+
+    if (m_sparse) {
+        AllocateNeighbourChunks();
+    }
+
+    RunChunkPasses([](const Chunk& chunk) { return !chunk.rect.IsEmpty(); },
+                   [this](Chunk& chunk) { chunk.updated = UpdateChunk(chunk); });
+
+    React([](const Chunk&) { return true; });
+
+    m_particles.Update(*this);
+
+    m_fields.Step(m_threadPool.get());
+    ApplyHotterPhases();
+    ApplyColderPhases();
+
+    if (m_levelingInterval > 0 && m_tick % m_levelingInterval == 0) {
+        LevelLiquids();
+    }
+
+    CatchUpChunks();
+    FinishMoves();
+    ExpireTimers();
+
+    m_cellsUpdated = 0;
+    m_cellsReactionChecked = 0;
+    for (Chunk& chunk : m_chunks) {
+        m_cellsUpdated += chunk.updated;
+        m_cellsReactionChecked += chunk.reactionChecked;
+        chunk.updated = 0;
+        chunk.reactionChecked = 0;
+    }
+
+    if (m_sparse) {
+        ReleaseEmptyChunks();
+    }
+    TrimCheckpoints();
+    UpdateStateHash();
+    m_changeStamp++;
+}
+
+// Zobrist key of a cell holding a material. Air's key is zero, so an
+// all-air chunk hashes to zero whether or not it is allocated.
+static uint64_t CellKey(int64_t id, MaterialType material) {
+    if (material == MaterialType::Air) {
+        return 0;
+    }
+    return MixBits(static_cast<uint64_t>(id) * MATERIAL_COUNT + static_cast<int>(material));
+}
+
+uint64_t World::GetContentHash() const {
+    uint64_t hash = 0;
+    for (const Chunk& chunk : m_chunks) {
+        hash ^= chunk.contentHash.value.load(std::memory_order_relaxed);
+    }
+    return hash;
+}
+
+uint64_t World::GetChunkContentHash(int chunkX, int chunkY) const {
+    int index = FindChunk(chunkX, chunkY);
+    return index < 0 ? 0 : m_chunks[index].contentHash.value.load(std::memory_order_relaxed);
+}
+
+// Key of a cell's velocity and timer lanes; zero when the cell has
+// neither, like Air's content key.
+static uint64_t LaneKey(int64_t id, int8_t velocityX, int8_t velocityY, bool timed, uint16_t timerTick) {
+    uint64_t lanes = static_cast<uint8_t>(velocityX) | static_cast<uint64_t>(static_cast<uint8_t>(velocityY)) << 8;
+    if (timed) {
+        lanes |= (static_cast<uint64_t>(timerTick) << 16) | (1ull << 32);
+    }
+    return lanes ? MixBits(MixBits(static_cast<uint64_t>(id)) ^ lanes) : 0;
+}
+
+// Air's lanes are left out, so a released sparse chunk, whose lanes are
+// reset, hashes as it did before.
+uint64_t World::HashChunkLanes(int chunk) const {
+    const Chunk& owner = m_chunks[chunk];
+    int x0 = owner.chunkX * CHUNK_SIZE;
+    int y0 = owner.chunkY * CHUNK_SIZE;
+    int width = std::min(CHUNK_SIZE, m_width - x0);
+    int height = std::min(CHUNK_SIZE, m_height - y0);
+    uint64_t hash = 0;
+    for (int y = y0; y < y0 + height; y++) {
+        size_t row = ChunkCellIndex(chunk, x0, y);
+        for (int x = 0; x < width; x++) {
+            size_t index = row + x;
+            if (m_pixels[index] != MaterialType::Air) {
+                hash ^= LaneKey(CellId(x0 + x, y), m_velocityX[index], m_velocityY[index],
+                                (m_flags[index] & CELL_TIMED) != 0, m_timerTick[index]);
+            }
+        }
+    }
+    return hash;
+}
+
+// Lanes only change in chunks the passes visited or that were written,
+// which records the current change stamp on them.
+void World::UpdateStateHash() {
+    uint64_t hash = MixBits(m_tick) ^ GetContentHash();
+    uint64_t lanes = 0;
+    for (size_t i = 0; i < m_chunks.size(); i++) {
+        Chunk& chunk = m_chunks[i];
+        if (!chunk.rect.IsEmpty() || chunk.changeStamp.value.load(std::memory_order_relaxed) >= m_laneHashStamp) {
+            chunk.laneHash = HashChunkLanes(static_cast<int>(i));
+        }
+        lanes ^= chunk.laneHash;
+    }
+    m_laneHashStamp = m_changeStamp + 1;
+    hash ^= MixBits(lanes ^ 0x9E3779B97F4A7C15ull);
+    hash ^= MixBits(m_fields.GetHash() + 1);
+    for (size_t i = 0; i < m_particles.GetCount(); i++) {
+        float position[2] = {m_particles.GetX(i), m_particles.GetY(i)};
+        uint64_t bits;
+        std::memcpy(&bits, position, sizeof(bits));
+        hash = MixBits(hash ^ bits ^ static_cast<uint64_t>(m_particles.GetMaterial(i)));
+    }
+    m_stateHash = hash;
+}
+
+void World::TakeChunkRect(Chunk& chunk) {
+    DirtyRect changed = chunk.changed.Take();
+    chunk.rect = changed;
+    chunk.rect.Include(chunk.lastChanged);
+    chunk.lastChanged = changed;
+
+    if (!chunk.rect.IsEmpty()) {
+        m_cellsScanned += static_cast<size_t>(chunk.rect.maxX - chunk.rect.minX + 1) *
+                          (chunk.rect.maxY - chunk.rect.minY + 1);
+    }
+}
+
+// Every move made so far is recorded in the chunks' moved lists. A timed
+// cell that moved gets a fresh event at its new position; the one it left
+// goes stale.
+void World::FinishMoves() {
+    for (Chunk& chunk : m_chunks) {
+        for (size_t index : chunk.moved) {
+            m_flags[index] &= ~CELL_MOVED;
+            if (m_flags[index] & CELL_TIMED) {
+                uint16_t left = m_timerTick[index] - static_cast<uint16_t>(m_tick);
+                int x, y;
+                CellPosition(index, x, y);
+                m_timers.Schedule(m_tick + left, CellId(x, y));
+            }
+        }
+        chunk.moved.clear();
+    }
+}
+
+void World::AddFocusRect(int x0, int y0, int x1, int y1) {
+    DirtyRect focus;
+    focus.Include(std::max(x0, 0) / CHUNK_SIZE, std::max(y0, 0) / CHUNK_SIZE,
+                  std::min(x1, m_width - 1) / CHUNK_SIZE, std::min(y1, m_height - 1) / CHUNK_SIZE);
+    m_focusRects.push_back(focus);
+}
+
+int World::GetChunkUpdateInterval(int chunkX, int chunkY) const {
+    if (m_focusRects.empty()) {
+        return 1;
+    }
+    int distance = INT_MAX;
+    for (const DirtyRect& focus : m_focusRects) {
+        int dx = std::max({focus.minX - chunkX, chunkX - focus.maxX, 0});
+        int dy = std::max({focus.minY - chunkY, chunkY - focus.maxY, 0});
+        distance = std::min(distance, std::max(dx, dy));
+    }
+    if (distance == 0) {
+        return 1;
+    }
+    return distance <= m_focusMargin ? 2 : m_distantInterval;
+}
+
+// Chunks sharing an interval are spread over its ticks by position, so
+// the deferred work does not all land on the same tick.
+bool World::IsChunkDue(const Chunk& chunk) const {
+    if (chunk.interval <= 1) {
+        return chunk.interval == 1;
+    }
+    return (m_tick + chunk.chunkX + chunk.chunkY) % chunk.interval == 0;
+}
+
+// Chunks back in focus replay the ticks they skipped with work pending, a
+// few rounds per tick so entering a busy area does not stall a frame.
+// Each round is a full checkerboard update of just those chunks with its
+// own random key.
+void World::CatchUpChunks() {
+    uint64_t tickKey = m_tickRandomKey;
+    for (int round = 1; round <= CATCH_UP_ROUNDS; round++) {
+        bool catchingUp = false;
+        for (Chunk& chunk : m_chunks) {
+            if (chunk.interval != 1 || chunk.backlog == 0) {
+                continue;
+            }
+            if (!catchingUp) {
+                FinishMoves();
+                catchingUp = true;
+            }
+            TakeChunkRect(chunk);
+            if (chunk.rect.IsEmpty()) {
+                // Asleep; replaying would change nothing
+                chunk.backlog = 0;
+            }
+        }
+        if (!catchingUp) {
+            break;
+        }
+
+        if (m_sparse) {
+            AllocateNeighbourChunks();
+        }
+        m_tickRandomKey = MixBits(tickKey + round);
+        auto replaying = [](const Chunk& chunk) { return chunk.interval == 1 && chunk.backlog > 0; };
+        RunChunkPasses(replaying, [this](Chunk& chunk) { chunk.updated += UpdateChunk(chunk); });
+        React(replaying);
+        for (Chunk& chunk : m_chunks) {
+            if (replaying(chunk)) {
+                chunk.backlog--;
+            }
+        }
+    }
+    m_tickRandomKey = tickKey;
+}
+
+void World::RunChunkPasses(const std::function<bool(const Chunk&)>& include,
+                           const std::function<void(Chunk&)>& task) {
+    // Tasks only write to their chunk and its neighbours, so saving those
+    // for the newest checkpoint up front keeps saves off the workers
+    if (m_newestCheckpoint != 0) {
+        for (size_t i = 0; i < m_chunks.size(); i++) {
+            if (!include(m_chunks[i])) {
+                continue;
+            }
+            int chunkX = m_chunks[i].chunkX;
+            int chunkY = m_chunks[i].chunkY;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int neighbour = FindChunk(chunkX + dx, chunkY + dy);
+                    if (neighbour >= 0) {
+                        PreserveChunk(neighbour);
+                    }
+                }
+            }
+        }
+    }
+
+    // 4-pass checkerboard: chunks in the same pass are two chunks apart,
+    // so they can run on different threads without sharing any cells.
+    for (int pass = 0; pass < 4; pass++) {
+        m_passChunks.clear();
+        for (size_t i = 0; i < m_chunks.size(); i++) {
+            const Chunk& chunk = m_chunks[i];
+            if ((chunk.chunkY & 1) == (pass & 1) && (chunk.chunkX & 1) == (pass >> 1) && include(chunk)) {
+                m_passChunks.push_back(static_cast<int>(i));
+            }
+        }
+
+        m_threadPool->ParallelFor(static_cast<int>(m_passChunks.size()), [&](int i) {
+            task(m_chunks[m_passChunks[i]]);
+        });
+    }
+}
+
+uint32_t World::ChunkMaterials(int chunkX, int chunkY) const {
+    if (chunkX < 0 || chunkX >= m_chunksX || chunkY < 0 || chunkY >= m_chunksY) {
+        return 0;
+    }
+    int index = FindChunk(chunkX, chunkY);
+    if (index < 0) {
+        return 1u << static_cast<int>(MaterialType::Air);
+    }
+    const Chunk& chunk = m_chunks[index];
+    uint32_t materials = 0;
+    for (int m = 0; m < MATERIAL_COUNT; m++) {
+        if (chunk.materialCounts[m].value.load(std::memory_order_relaxed) > 0) {
+            materials |= 1u << m;
+        }
+    }
+    return materials;
+}
+
+void World::CountMaterial(int chunk, MaterialType removed, MaterialType added) {
+    m_chunks[chunk].materialCounts[static_cast<int>(removed)].value.fetch_sub(1, std::memory_order_relaxed);
+    m_chunks[chunk].materialCounts[static_cast<int>(added)].value.fetch_add(1, std::memory_order_relaxed);
+}
+
+int World::ChunkCellCount(int chunkX, int chunkY) const {
+    return (std::min((chunkX + 1) * CHUNK_SIZE, m_width) - chunkX * CHUNK_SIZE) *
+           (std::min((chunkY + 1) * CHUNK_SIZE, m_height) - chunkY * CHUNK_SIZE);
+}
+
+void World::ResetMaterialCounts() {
+    for (Chunk& chunk : m_chunks) {
+        for (int m = 0; m < MATERIAL_COUNT; m++) {
+            chunk.materialCounts[m].value.store(0, std::memory_order_relaxed);
+        }
+        chunk.materialCounts[static_cast<int>(MaterialType::Air)].value.store(
+            ChunkCellCount(chunk.chunkX, chunk.chunkY), std::memory_order_relaxed);
+    }
+}
+
+int World::GetChunkMaterialCount(int chunkX, int chunkY, MaterialType material) const {
+    if (chunkX < 0 || chunkX >= m_chunksX || chunkY < 0 || chunkY >= m_chunksY) {
+        return 0;
+    }
+    int index = FindChunk(chunkX, chunkY);
+    if (index < 0) {
+        return material == MaterialType::Air ? ChunkCellCount(chunkX, chunkY) : 0;
+    }
+    return m_chunks[index].materialCounts[static_cast<int>(material)].value.load(std::memory_order_relaxed);
+}
+
+// Contact reactions run after the cells move, in their own checkerboard
+// passes over the awake chunks. A chunk only takes part when its material
+// counts and its neighbours' hold both sides of some rule, so a world
+// without reactive pairs pays for a few mask operations per chunk.
+void World::React(const std::function<bool(const Chunk&)>& include) {
+    for (Chunk& chunk : m_chunks) {
+        chunk.reactive = 0;
+        if (chunk.rect.IsEmpty() || !include(chunk)) {
+            continue;
+        }
+        uint32_t own = ChunkMaterials(chunk.chunkX, chunk.chunkY);
+        uint32_t nearby = own;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                nearby |= ChunkMaterials(chunk.chunkX + dx, chunk.chunkY + dy);
+            }
+        }
+        for (uint32_t set = own; set; set &= set - 1) {
+            int m = __builtin_ctz(set);
+            if (REACTION_TABLE.partners[m] & nearby) {
+                chunk.reactive |= 1u << m;
+            }
+        }
+    }
+
+    // Separate stream from the movement kernels' CellRandom
+    uint64_t key = MixBits(m_tickRandomKey ^ 0xD1B54A32D192ED03ull);
+    RunChunkPasses([](const Chunk& chunk) { return chunk.reactive != 0; },
+                   [this, key](Chunk& chunk) {
+                       chunk.reactionChecked += m_sparse
+                           ? ReactChunk(chunk.rect, chunk.reactive, key, SparseCellsAround(chunk))
+                           : ReactChunk(chunk.rect, chunk.reactive, key, DenseCellsOf());
+                   });
+}
+
+// Cells reads the world's edge as Stone, which must never react.
+static_assert(REACTION_TABLE.partners[static_cast<int>(MaterialType::Stone)] == 0,
+              "ReactChunk reads cells outside the world as Stone");
+
+// Visits the rect's cells of reactive materials, found a row at a time with
+// MaterialSetMask, and rolls for the first neighbour they have a rule with.
+// A failed roll keeps the pair awake so the reaction is not lost to sleep.
+template <typename Cells>
+size_t World::ReactChunk(const DirtyRect& rect, uint32_t reactive, uint64_t key, const Cells& cells) {
+    int rowWidth = rect.maxX - rect.minX + 1;
+    size_t checked = 0;
+
+    for (int y = rect.minY; y <= rect.maxY; y++) {
+        const MaterialType* row = &m_pixels[cells.Index(rect.minX, y)];
+        for (uint64_t found = MaterialSetMask(row, rowWidth, reactive); found; found &= found - 1) {
+            int bit = LowestBit(found);
+            int x = rect.minX + bit;
+            int self = static_cast<int>(row[bit]);
+            checked++;
+
+            const int neighbours[4][2] = {{x, y + 1}, {x, y - 1}, {x - 1, y}, {x + 1, y}};
+            for (const auto& n : neighbours) {
+                const ReactionEntry& rule = REACTION_TABLE.entries[self][static_cast<int>(cells.Cell(n[0], n[1]))];
+                if (rule.threshold == 0) {
+                    continue;
+                }
+                if (CellRandom(key, x, y) < rule.threshold) {
+                    SetPixel(n[0], n[1], rule.otherBecomes);
+                    SetPixel(x, y, rule.becomes);
+                    AddHeat(x, y, rule.heat);
+                } else {
+                    MarkDirty(x, y);
+                }
+                break;
+            }
+        }
+    }
+    return checked;
+}
+
+// Only samples at or above the lowest transition temperature are looked at,
+// so a cool world pays for one compare per sample.
+void World::ApplyHotterPhases() {
+    constexpr float threshold = LowestHotterPhaseTemperature();
+    if (!m_heat) {
+        return;
+    }
+    // Only dense worlds carry fields
+    DenseCells cells = DenseCellsOf();
+    for (int sy = 0; sy < m_heat->GetHeight(); sy++) {
+        for (int sx = 0; sx < m_heat->GetWidth(); sx++) {
+            float heat = m_heat->Get(sx, sy);
+            if (heat < threshold) {
+                continue;
+            }
+
+            int x1 = std::min((sx + 1) * FIELD_CELL_SIZE, m_width);
+            int y1 = std::min((sy + 1) * FIELD_CELL_SIZE, m_height);
+            for (int y = sy * FIELD_CELL_SIZE; y < y1; y++) {
+                for (int x = sx * FIELD_CELL_SIZE; x < x1; x++) {
+                    MaterialType material = cells.Cell(x, y);
+                    const PhaseChange& phase = PHASE_CHANGES[static_cast<int>(material)];
+                    if (phase.hotter != material && heat > phase.hotterAbove) {
+                        SetPixel(x, y, phase.hotter);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Cooling is driven by the chunks' material counts rather than by the
+// kernels, so resting cells and cells in sleeping chunks cool down too.
+// Only chunks holding a material with a colder phase are looked at, a row
+// mask of those materials at a time.
+void World::ApplyColderPhases() {
+    constexpr uint32_t cooling = ColderPhaseMaterials();
+    for (size_t chunk = 0; chunk < m_chunks.size(); chunk++) {
+        int chunkX = m_chunks[chunk].chunkX;
+        int chunkY = m_chunks[chunk].chunkY;
+        uint32_t materials = ChunkMaterials(chunkX, chunkY) & cooling;
+        if (!materials) {
+            continue;
+        }
+
+        int x0 = chunkX * CHUNK_SIZE;
+        int y0 = chunkY * CHUNK_SIZE;
+        int width = std::min(CHUNK_SIZE, m_width - x0);
+        int y1 = std::min(y0 + CHUNK_SIZE, m_height);
+        for (int y = y0; y < y1; y++) {
+            size_t row = ChunkCellIndex(static_cast<int>(chunk), x0, y);
+            for (uint64_t cells = MaterialSetMask(&m_pixels[row], width, materials); cells; cells &= cells - 1) {
+                int x = x0 + LowestBit(cells);
+                const PhaseChange& phase = PHASE_CHANGES[static_cast<int>(m_pixels[row + LowestBit(cells)])];
+                if (GetHeat(x, y) < phase.colderBelow) {
+                    SetPixel(x, y, phase.colder);
+                }
+            }
+        }
+    }
+}
+
+// Seeds a flood fill from every liquid cell in this tick's dirty rects, so
+// bodies that have settled and gone to sleep cost nothing.
+void World::LevelLiquids() {
+    m_levelVisited.clear();
+
+    // Bodies are seeded in row order of chunks whatever the storage, since
+    // the seed order decides where a shared surface settles. Chunks that
+    // levelling allocates have nothing to seed.
+    m_passChunks.clear();
+    for (size_t chunk = 0; chunk < m_chunks.size(); chunk++) {
+        if (!m_chunks[chunk].rect.IsEmpty()) {
+            m_passChunks.push_back(static_cast<int>(chunk));
+        }
+    }
+    if (m_sparse) {
+        std::sort(m_passChunks.begin(), m_passChunks.end(), [this](int a, int b) {
+            return std::make_pair(m_chunks[a].chunkY, m_chunks[a].chunkX) <
+                   std::make_pair(m_chunks[b].chunkY, m_chunks[b].chunkX);
+        });
+    }
+
+    for (int chunk : m_passChunks) {
+        // Copied, since allocation can move m_chunks
+        DirtyRect rect = m_chunks[chunk].rect;
+        for (int y = rect.minY; y <= rect.maxY; y++) {
+            size_t row = ChunkCellIndex(chunk, rect.minX, y);
+            for (int x = rect.minX; x <= rect.maxX; x++) {
+                size_t index = row + (x - rect.minX);
+                if (MATERIAL_PROPERTIES[static_cast<int>(m_pixels[index])].isLiquid &&
+                    !(m_flags[index] & CELL_LEVELED)) {
+                    LevelBody(x, y);
+                }
+            }
+        }
+    }
+
+    for (size_t index : m_levelVisited) {
+        m_flags[index] &= ~CELL_LEVELED;
+    }
+}
+
+// Sources are body cells with air above, highest (lowest CellId) first;
+// targets are air cells next to the body that rest on something, lowest
+// (highest CellId) first. Moving the top source into the bottom target
+// until no target lies below any source levels the surface, including
+// across communicating vessels. Air under the body is left to the kernels,
+// and a body that rests on nothing is falling and is not levelled at all,
+// so levelling never moves liquid faster than it falls.
+void World::LevelBody(int seedX, int seedY) {
+    MaterialType liquid = m_pixels[Index(seedX, seedY)];
+    std::vector<int64_t>& sources = m_levelSources;
+    std::vector<int64_t>& targets = m_levelTargets;
+    std::vector<int64_t>& stack = m_levelStack;
+    sources.clear();
+    targets.clear();
+    stack.clear();
+
+    auto isAir = [&](int x, int y) { return InBounds(x, y) && m_pixels[Index(x, y)] == MaterialType::Air; };
+    auto isTarget = [&](int x, int y) { return isAir(x, y) && !isAir(x, y + 1); };
+    auto addTargets = [&](int x, int y) {
+        if (isTarget(x, y - 1)) targets.push_back(CellId(x, y - 1));
+        if (isTarget(x - 1, y)) targets.push_back(CellId(x - 1, y));
+        if (isTarget(x + 1, y)) targets.push_back(CellId(x + 1, y));
+    };
+
+    size_t seed = Index(seedX, seedY);
+    m_flags[seed] |= CELL_LEVELED;
+    m_levelVisited.push_back(seed);
+    stack.push_back(CellId(seedX, seedY));
+    bool resting = false;
+    while (!stack.empty()) {
+        int64_t id = stack.back();
+        stack.pop_back();
+        int x = static_cast<int>(id % m_width);
+        int y = static_cast<int>(id / m_width);
+
+        MaterialType below = GetPixel(x, y + 1);
+        resting |= below != MaterialType::Air && below != liquid;
+        if (isAir(x, y - 1)) {
+            sources.push_back(id);
+        }
+        addTargets(x, y);
+
+        const int neighbours[4][2] = {{x - 1, y}, {x + 1, y}, {x, y - 1}, {x, y + 1}};
+        for (const auto& n : neighbours) {
+            if (!InBounds(n[0], n[1])) {
+                continue;
+            }
+            size_t next = Index(n[0], n[1]);
+            if (m_pixels[next] == liquid && !(m_flags[next] & CELL_LEVELED)) {
+                m_flags[next] |= CELL_LEVELED;
+                m_levelVisited.push_back(next);
+                stack.push_back(CellId(n[0], n[1]));
+            }
+        }
+    }
+
+    if (!resting) {
+        return;
+    }
+
+    std::greater<int64_t> highestFirst;
+    std::less<int64_t> lowestFirst;
+    std::make_heap(sources.begin(), sources.end(), highestFirst);
+    std::make_heap(targets.begin(), targets.end(), lowestFirst);
+
+    while (!sources.empty() && !targets.empty()) {
+        int64_t source = sources.front();
+        int64_t target = targets.front();
+        int sourceX = static_cast<int>(source % m_width);
+        int sourceY = static_cast<int>(source / m_width);
+
+        // Entries go stale as cells move; they are dropped when they surface
+        if (m_pixels[Index(sourceX, sourceY)] != liquid || !isAir(sourceX, sourceY - 1)) {
+            std::pop_heap(sources.begin(), sources.end(), highestFirst);
+            sources.pop_back();
+            continue;
+        }
+        int targetX = static_cast<int>(target % m_width);
+        int targetY = static_cast<int>(target / m_width);
+        if (!isTarget(targetX, targetY)) {
+            std::pop_heap(targets.begin(), targets.end(), lowestFirst);
+            targets.pop_back();
+            continue;
+        }
+        if (targetY <= sourceY) {
+            break;
+        }
+
+        std::pop_heap(sources.begin(), sources.end(), highestFirst);
+        sources.pop_back();
+        std::pop_heap(targets.begin(), targets.end(), lowestFirst);
+        targets.pop_back();
+        // The target can lie in a sparse chunk that is not allocated yet
+        size_t filled = WritableIndex(targetX, targetY);
+        SwapPixels(sourceX, sourceY, targetX, targetY);
+        m_flags[filled] |= CELL_LEVELED;
+        m_levelVisited.push_back(filled);
+
+        // The cell under the old source is now on the surface, and the
+        // filled target may be a source with new targets beside and above
+        // it; the cell under it is not air, since the target rested on it
+        if (InBounds(sourceX, sourceY + 1) && m_pixels[Index(sourceX, sourceY + 1)] == liquid) {
+            sources.push_back(CellId(sourceX, sourceY + 1));
+            std::push_heap(sources.begin(), sources.end(), highestFirst);
+        }
+        if (isAir(targetX, targetY - 1)) {
+            sources.push_back(target);
+            std::push_heap(sources.begin(), sources.end(), highestFirst);
+        }
+        size_t firstNew = targets.size();
+        addTargets(targetX, targetY);
+        for (size_t i = firstNew; i < targets.size(); i++) {
+            std::push_heap(targets.begin(), targets.begin() + i + 1, lowestFirst);
+        }
+    }
 }
 
-void World::Update() {
-    m_updateDirection = !m_updateDirection;
-    
-    for (int y = m_height - 2; y >= 0; y--) {
+size_t World::UpdateChunk(Chunk& chunk) {
+    return m_sparse ? UpdateCells(chunk.rect, SparseCellsAround(chunk))
+                    : UpdateCells(chunk.rect, DenseCellsOf());
+}
+
+// Neighbours outside the world keep the air block; the bounds check stops
+// the kernels before they index it.
+World::SparseCells World::SparseCellsAround(const Chunk& chunk) {
+    SparseCells cells{m_pixels.data(), m_blockChunks.data(), m_width, m_height,
+                      (chunk.chunkX - 1) * CHUNK_SIZE, (chunk.chunkY - 1) * CHUNK_SIZE, {}};
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            int neighbour = FindChunk(chunk.chunkX + dx, chunk.chunkY + dy);
+            cells.blocks[dy + 1][dx + 1] = neighbour < 0 ? 0 : m_chunkBlocks[neighbour + 1] * CHUNK_CELLS;
+        }
+    }
+    return cells;
+}
+
+template <typename Cells>
+size_t World::UpdateCells(const DirtyRect& rect, const Cells& cells) {
+    // A rect never spans more than one chunk, so each row fits in one mask
+    int rowWidth = rect.maxX - rect.minX + 1;
+    int chunkX = rect.minX / CHUNK_SIZE;
+    uint64_t columns = (rowWidth == 64 ? ~0ull : (1ull << rowWidth) - 1) << (rect.minX % CHUNK_SIZE);
+    size_t updated = 0;
+
+    for (int y = rect.maxY; y >= rect.minY; y--) {
+        uint64_t movable = MovableMask(&m_pixels[cells.Index(rect.minX, y)], rowWidth);
+        if (m_bitPlanes && y + 1 < m_height) {
+            int shift = rect.minX % CHUNK_SIZE;
+            movable &= ~(DropPowderRow(chunkX, y, columns, movable << shift) >> shift);
+        }
+
         if (m_updateDirection) {
-            for (int x = 0; x < m_width; x++) {
-                UpdatePixel(x, y);
+            while (movable) {
+                int bit = LowestBit(movable);
+                movable &= movable - 1;
+                updated += UpdatePixel(rect.minX + bit, y, cells);
+            }
+        } else {
+            while (movable) {
+                int bit = HighestBit(movable);
+                movable &= ~(1ull << bit);
+                updated += UpdatePixel(rect.minX + bit, y, cells);
             }
+        }
+    }
+    return updated;
+}
+
+// Keeps the grains of falling that the per-cell scan would also move
+// straight down. The cell scanned just before a grain may slide into the
+// cell below it, or flow into the cell it leaves, unless that cell is
+// pinned (it cannot move) or drops as well. So a run of adjacent grains
+// drops only if the cell scanned before its first grain is pinned.
+static uint64_t DropsInScanOrder(uint64_t falling, uint64_t pinned, bool ascending) {
+    uint64_t drops;
+    if (ascending) {
+        drops = falling & ~(falling << 1) & ((pinned << 1) | 1);
+    } else {
+        drops = falling & ~(falling >> 1) & ((pinned >> 1) | (1ull << 63));
+    }
+    // Spread each accepted first grain along its run, doubling the reach
+    // each step
+    uint64_t run = falling;
+    for (int shift = 1; shift < 64; shift *= 2) {
+        if (ascending) {
+            drops |= run & (drops << shift);
+            run &= run << shift;
         } else {
-            for (int x = m_width - 1; x >= 0; x--) {
-                UpdatePixel(x, y);
+            drops |= run & (drops >> shift);
+            run &= run >> shift;
+        }
+    }
+    return drops;
+}
+
+// Moves the powder cells in the masked columns of row y whose cell below
+// is empty down one row, before that row's kernels run, and returns their
+// columns. movable holds the row's non-static cells. Only grains that the
+// kernels would also move straight down in scan order are dropped; the
+// rest are left to their kernel. Pixels, flags and lanes of all the
+// grains move at once with masked word swaps; only the hash keys and the
+// moved list are kept per grain.
+uint64_t World::DropPowderRow(int chunkX, int y, uint64_t columns, uint64_t movable) {
+    size_t word = PlaneWord(chunkX * CHUNK_SIZE, y);
+    size_t below = word + m_chunksX;
+    uint64_t falling = m_powderBits[word].load(std::memory_order_relaxed) &
+                       m_emptyBits[below].load(std::memory_order_relaxed) & columns;
+    if (!falling) {
+        return 0;
+    }
+
+    // Bit planes are only kept for dense storage
+    DenseCells cells = DenseCellsOf();
+    int x0 = chunkX * CHUNK_SIZE;
+    int width = std::min(CHUNK_SIZE, m_width - x0);
+    size_t from = cells.Index(x0, y);
+    size_t to = cells.Index(x0, y + 1);
+    for (uint64_t bits = falling; bits; bits &= bits - 1) {
+        int bit = LowestBit(bits);
+        // Grains fast enough to fall further are left to their kernel
+        if ((m_flags[from + bit] & CELL_MOVED) || m_velocityY[from + bit] >= FALL_VELOCITY_PER_CELL) {
+            falling &= ~(1ull << bit);
+        }
+    }
+    // Cells outside the rect are not scanned with this row
+    falling = DropsInScanOrder(falling, ~(movable & columns), m_updateDirection);
+    if (!falling) {
+        return 0;
+    }
+
+    int fromChunk = cells.ChunkOf(from, x0, y);
+    int toChunk = cells.ChunkOf(to, x0, y + 1);
+    PreserveChunk(fromChunk);
+    PreserveChunk(toChunk);
+    int64_t id = CellId(x0, y);
+    uint64_t fromKeys = 0;
+    uint64_t toKeys = 0;
+    int grains[MATERIAL_COUNT] = {};
+    std::vector<size_t>& moved = m_chunks[fromChunk].moved;
+    for (uint64_t bits = falling; bits; bits &= bits - 1) {
+        int bit = LowestBit(bits);
+        MaterialType grain = m_pixels[from + bit];
+        fromKeys ^= CellKey(id + bit, grain);
+        toKeys ^= CellKey(id + bit + m_width, grain);
+        grains[static_cast<int>(grain)]++;
+        // Set on the grain before the swap carries it down; air never
+        // carries CELL_MOVED, so only the grain is recorded
+        m_velocityY[from + bit] = static_cast<int8_t>(std::max<int>(m_velocityY[from + bit], 0) + 1);
+        m_flags[from + bit] |= CELL_MOVED;
+        moved.push_back(to + bit);
+    }
+
+    SwapMasked(&m_pixels[from], &m_pixels[to], falling, width);
+    SwapMasked(&m_flags[from], &m_flags[to], falling, width);
+    SwapLanes(from, to, falling, width);
+    XorContentHash(fromChunk, fromKeys);
+    XorContentHash(toChunk, toKeys);
+    if (fromChunk != toChunk) {
+        int total = 0;
+        for (int m = 0; m < MATERIAL_COUNT; m++) {
+            if (grains[m] != 0) {
+                m_chunks[fromChunk].materialCounts[m].value.fetch_sub(grains[m], std::memory_order_relaxed);
+                m_chunks[toChunk].materialCounts[m].value.fetch_add(grains[m], std::memory_order_relaxed);
+                total += grains[m];
             }
         }
+        int air = static_cast<int>(MaterialType::Air);
+        m_chunks[fromChunk].materialCounts[air].value.fetch_add(total, std::memory_order_relaxed);
+        m_chunks[toChunk].materialCounts[air].value.fetch_sub(total, std::memory_order_relaxed);
     }
+
+    m_powderBits[word].fetch_and(~falling, std::memory_order_relaxed);
+    m_emptyBits[word].fetch_or(falling, std::memory_order_relaxed);
+    m_powderBits[below].fetch_or(falling, std::memory_order_relaxed);
+    m_emptyBits[below].fetch_and(~falling, std::memory_order_relaxed);
+    MarkDirty(x0 + LowestBit(falling) - 1, y - 1, x0 + HighestBit(falling) + 1, y + 2);
+    return falling;
 }
 
 void World::SetPixel(int x, int y, MaterialType material) {
-    if (InBounds(x, y)) {
-        m_pixels[y * m_width + x] = material;
+    if (InBounds(x, y) && m_pixels[Index(x, y)] != material) {
+        // Unallocated sparse chunks are all air, so only writes of another
+        // material get this far and allocate
+        size_t index = WritableIndex(x, y);
+        int chunk = ChunkIndex(x, y);
+        PreserveChunk(chunk);
+        CountMaterial(chunk, m_pixels[index], material);
+        XorContentHash(chunk, CellKey(CellId(x, y), m_pixels[index]) ^ CellKey(CellId(x, y), material));
+        m_pixels[index] = material;
+        m_flags[index] = 0;
+        ResetLanes(index);
+        StartLifetimeTimer(x, y, material);
+        if (m_bitPlanes) {
+            SyncBitPlanes(x, y);
+        }
+        MarkDirty(x, y);
+    }
+}
+
+void World::StartLifetimeTimer(int x, int y, MaterialType material) {
+    const TimedTransition& timed = TIMED_TRANSITIONS[static_cast<int>(material)];
+    if (timed.lifetime > 0) {
+        int jitter = CellRandom(m_tickRandomKey ^ 0x6A09E667F3BCC909ull, x, y) % (timed.lifetimeJitter + 1);
+        StartTimer(x, y, timed.lifetime + jitter);
+    }
+}
+
+void World::WriteSpan(int y, int x0, int x1, const MaterialType* cells, MaterialType material,
+                      const uint8_t* mask, DirtyRect& changed) {
+    for (int start = x0, end = x0; start <= x1; start = end + 1) {
+        end = std::min(x1, (start / CHUNK_SIZE + 1) * CHUNK_SIZE - 1);
+        int count = end - start + 1;
+        const MaterialType* source = cells ? cells + (start - x0) : nullptr;
+        const uint8_t* written = mask ? mask + (start - x0) : nullptr;
+
+        int chunk = ChunkIndex(start, y);
+        if (chunk < 0) {
+            // Unallocated sparse chunks are all air, as in SetPixel
+            bool air = true;
+            for (int i = 0; i < count && air; i++) {
+                air = (written && !written[i]) || (source ? source[i] : material) == MaterialType::Air;
+            }
+            if (air) {
+                continue;
+            }
+            chunk = EnsureChunk(start / CHUNK_SIZE, y / CHUNK_SIZE);
+        }
+        PreserveChunk(chunk);
+
+        // Old cells are read once for counts and hashes. Spans never leave
+        // a chunk row, so the changed cells fit one mask; lanes of a wholly
+        // changed span and the cells without a mask are written in one go.
+        size_t index = ChunkCellIndex(chunk, start, y);
+        MaterialType* row = &m_pixels[index];
+        int64_t id = CellId(start, y);
+        int counts[MATERIAL_COUNT] = {};
+        uint64_t keys = 0;
+        uint64_t changedCells = 0;
+        for (int i = 0; i < count; i++) {
+            MaterialType next = source ? source[i] : material;
+            if ((written && !written[i]) || row[i] == next) {
+                continue;
+            }
+            counts[static_cast<int>(row[i])]--;
+            counts[static_cast<int>(next)]++;
+            keys ^= CellKey(id + i, row[i]) ^ CellKey(id + i, next);
+            changedCells |= 1ull << i;
+        }
+        if (!changedCells) {
+            continue;
+        }
+
+        if (changedCells == (count == 64 ? ~0ull : (1ull << count) - 1)) {
+            ResetLanes(index, count);
+        } else {
+            for (uint64_t bits = changedCells; bits; bits &= bits - 1) {
+                m_flags[index + LowestBit(bits)] = 0;
+                ResetLanes(index + LowestBit(bits));
+            }
+        }
+        if (written) {
+            for (uint64_t bits = changedCells; bits; bits &= bits - 1) {
+                row[LowestBit(bits)] = source[LowestBit(bits)];
+            }
+        } else if (source) {
+            std::memcpy(row, source, count * sizeof(MaterialType));
+        } else {
+            std::memset(row, static_cast<int>(material), count * sizeof(MaterialType));
+        }
+        for (uint64_t bits = changedCells; bits; bits &= bits - 1) {
+            StartLifetimeTimer(start + LowestBit(bits), y, row[LowestBit(bits)]);
+        }
+
+        for (int m = 0; m < MATERIAL_COUNT; m++) {
+            if (counts[m] != 0) {
+                m_chunks[chunk].materialCounts[m].value.fetch_add(counts[m], std::memory_order_relaxed);
+            }
+        }
+        XorContentHash(chunk, keys);
+        if (m_bitPlanes) {
+            uint64_t span = 0;
+            uint64_t empty = 0;
+            uint64_t powder = 0;
+            for (int i = 0; i < count; i++) {
+                uint64_t bit = 1ull << ((start + i) % CHUNK_SIZE);
+                span |= bit;
+                empty |= row[i] == MaterialType::Air ? bit : 0;
+                powder |= MATERIAL_PROPERTIES[static_cast<int>(row[i])].behavior == MaterialBehavior::Powder ? bit : 0;
+            }
+            size_t word = PlaneWord(start, y);
+            m_emptyBits[word].store((m_emptyBits[word].load(std::memory_order_relaxed) & ~span) | empty,
+                                    std::memory_order_relaxed);
+            m_powderBits[word].store((m_powderBits[word].load(std::memory_order_relaxed) & ~span) | powder,
+                                     std::memory_order_relaxed);
+        }
+        changed.Include(start + LowestBit(changedCells), y, start + HighestBit(changedCells), y);
+    }
+}
+
+void World::FillRect(int x0, int y0, int x1, int y1, MaterialType material) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, m_width - 1);
+    y1 = std::min(y1, m_height - 1);
+    DirtyRect changed;
+    for (int y = y0; y <= y1 && x0 <= x1; y++) {
+        WriteSpan(y, x0, x1, nullptr, material, nullptr, changed);
+    }
+    if (!changed.IsEmpty()) {
+        MarkDirty(changed.minX - 1, changed.minY - 1, changed.maxX + 1, changed.maxY + 1);
+    }
+}
+
+void World::FillCircle(int centerX, int centerY, int radius, MaterialType material) {
+    if (radius < 0) {
+        return;
+    }
+    if (radius != m_circleRadius) {
+        m_circleSpans.resize(2 * radius + 1);
+        int limit = radius * radius;
+        for (int dy = -radius; dy <= radius; dy++) {
+            int half = static_cast<int>(std::sqrt(static_cast<double>(limit - dy * dy)));
+            while (half * half + dy * dy > limit) half--;
+            while ((half + 1) * (half + 1) + dy * dy <= limit) half++;
+            m_circleSpans[dy + radius] = half;
+        }
+        m_circleRadius = radius;
+    }
+
+    DirtyRect changed;
+    for (int dy = -radius; dy <= radius; dy++) {
+        int y = centerY + dy;
+        int half = m_circleSpans[dy + radius];
+        int x0 = std::max(centerX - half, 0);
+        int x1 = std::min(centerX + half, m_width - 1);
+        if (y >= 0 && y < m_height && x0 <= x1) {
+            WriteSpan(y, x0, x1, nullptr, material, nullptr, changed);
+        }
+    }
+    if (!changed.IsEmpty()) {
+        MarkDirty(changed.minX - 1, changed.minY - 1, changed.maxX + 1, changed.maxY + 1);
+    }
+}
+
+void World::Blit(int x, int y, int width, int height, const MaterialType* cells, size_t stride,
+                 const uint8_t* mask) {
+    int x0 = std::max(x, 0);
+    int x1 = std::min(x + width - 1, m_width - 1);
+    DirtyRect changed;
+    for (int row = std::max(-y, 0); row < height && y + row < m_height && x0 <= x1; row++) {
+        size_t offset = row * stride + (x0 - x);
+        WriteSpan(y + row, x0, x1, cells + offset, MaterialType::Air, mask ? mask + offset : nullptr, changed);
+    }
+    if (!changed.IsEmpty()) {
+        MarkDirty(changed.minX - 1, changed.minY - 1, changed.maxX + 1, changed.maxY + 1);
+    }
+}
+
+void World::Blit(const World& source, int sourceX, int sourceY, int width, int height, int x, int y) {
+    // Clip to the source, then copy first so the source may be this world
+    int left = std::max(-sourceX, 0);
+    int top = std::max(-sourceY, 0);
+    width = std::min(width, source.GetWidth() - sourceX) - left;
+    height = std::min(height, source.GetHeight() - sourceY) - top;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    std::vector<MaterialType> cells(static_cast<size_t>(width) * height);
+    source.CopyRegion(sourceX + left, sourceY + top, width, height, cells.data(), width);
+    Blit(x + left, y + top, width, height, cells.data(), width);
+}
+
+void World::CopyRegion(int x, int y, int width, int height, MaterialType* out, size_t stride) const {
+    for (int row = 0; row < height; row++) {
+        MaterialType* line = out + row * stride;
+        int cellY = y + row;
+        if (cellY < 0 || cellY >= m_height) {
+            std::fill(line, line + width, MaterialType::Stone);
+            continue;
+        }
+        for (int column = 0; column < width;) {
+            int cellX = x + column;
+            if (cellX < 0 || cellX >= m_width) {
+                line[column++] = MaterialType::Stone;
+                continue;
+            }
+            int count = std::min({width - column, CHUNK_SIZE - cellX % CHUNK_SIZE, m_width - cellX});
+            const MaterialType* cells = &m_pixels[Index(cellX, cellY)];
+            std::copy(cells, cells + count, line + column);
+            column += count;
+        }
+    }
+}
+
+bool World::EjectPixel(int x, int y, float velocityX, float velocityY) {
+    MaterialType material = GetPixel(x, y);
+    if (!InBounds(x, y) || material == MaterialType::Air ||
+        !m_particles.Spawn(x + 0.5f, y + 0.5f, velocityX, velocityY, material)) {
+        return false;
+    }
+    SetPixel(x, y, MaterialType::Air);
+    return true;
+}
+
+float World::GetHeat(int x, int y) const {
+    return m_heat ? m_heat->Get(x / FIELD_CELL_SIZE, y / FIELD_CELL_SIZE) : AMBIENT_TEMPERATURE;
+}
+
+bool World::AddHeat(int x, int y, float amount) {
+    if (!m_heat || !InBounds(x, y)) {
+        return false;
     }
+    m_heat->Add(x / FIELD_CELL_SIZE, y / FIELD_CELL_SIZE, amount);
+    return true;
 }
 
 MaterialType World::GetPixel(int x, int y) const {
     if (InBounds(x, y)) {
-        return m_pixels[y * m_width + x];
+        return m_pixels[Index(x, y)];
     }
     return MaterialType::Stone;
 }
 
+uint64_t World::GetChunkChangeStamp(int chunkX, int chunkY) const {
+    if (chunkX < 0 || chunkX >= m_chunksX || chunkY < 0 || chunkY >= m_chunksY) {
+        return 0;
+    }
+    int index = FindChunk(chunkX, chunkY);
+    if (index < 0) {
+        return m_releaseStamp;
+    }
+    return m_chunks[index].changeStamp.value.load(std::memory_order_relaxed);
+}
+
+void World::CopyChunkCells(int chunkX, int chunkY, MaterialType* out, size_t stride) const {
+    int x0 = chunkX * CHUNK_SIZE;
+    int y0 = chunkY * CHUNK_SIZE;
+    int width = std::min(CHUNK_SIZE, m_width - x0);
+    int height = std::min(CHUNK_SIZE, m_height - y0);
+    int chunk = FindChunk(chunkX, chunkY);
+    for (int y = 0; y < height; y++) {
+        MaterialType* row = out + y * stride;
+        if (chunk < 0) {
+            std::fill(row, row + width, MaterialType::Air);
+        } else {
+            const MaterialType* cells = &m_pixels[ChunkCellIndex(chunk, x0, y0 + y)];
+            std::copy(cells, cells + width, row);
+        }
+    }
+}
+
+bool World::IsChunkAwake(int chunkX, int chunkY) const {
+    int index = FindChunk(chunkX, chunkY);
+    if (index < 0) {
+        return false;
+    }
+    const Chunk& chunk = m_chunks[index];
+    return !chunk.changed.IsEmpty() || !chunk.rect.IsEmpty() || !chunk.lastChanged.IsEmpty();
+}
+
 void World::Clear() {
+    for (size_t i = 0; i < m_chunks.size(); i++) {
+        const Chunk& chunk = m_chunks[i];
+        int air = chunk.materialCounts[static_cast<int>(MaterialType::Air)].value.load(std::memory_order_relaxed);
+        if (air != ChunkCellCount(chunk.chunkX, chunk.chunkY)) {
+            PreserveChunk(static_cast<int>(i));
+        }
+    }
+    if (m_sparse) {
+        m_chunks.clear();
+        m_chunkSlots.clear();
+        m_chunkBlocks.assign(1, 0);
+        m_blockChunks.assign(1, -1);
+        m_freeBlocks.clear();
+        ResizeStorage(CHUNK_CELLS);
+        m_releaseStamp = m_changeStamp;
+    }
     std::fill(m_pixels.begin(), m_pixels.end(), MaterialType::Air);
+    if (!m_sparse) {
+        FillBorder();
+    }
+    std::fill(m_flags.begin(), m_flags.end(), 0);
+    std::fill(m_velocityX.begin(), m_velocityX.end(), 0);
+    std::fill(m_velocityY.begin(), m_velocityY.end(), 0);
+    std::fill(m_timerTick.begin(), m_timerTick.end(), 0);
+    m_timers.Reset(m_tick);
+    m_particles.Clear();
+    m_fields.Reset();
+    for (Chunk& chunk : m_chunks) {
+        chunk.rect = DirtyRect();
+        chunk.changed.Take();
+        chunk.lastChanged = DirtyRect();
+        chunk.moved.clear();
+        chunk.backlog = 0;
+        chunk.changeStamp.value.store(m_changeStamp, std::memory_order_relaxed);
+        chunk.contentHash.value.store(0, std::memory_order_relaxed);
+    }
+    ResetMaterialCounts();
+    if (m_bitPlanes) {
+        RebuildBitPlanes();
+    }
+}
+
+uint64_t World::TakeCheckpoint() {
+    // Writes from here on stamp chunks newer than any copy this one saves
+    m_changeStamp++;
+    m_checkpoints.emplace_back();
+    m_checkpoints.back().id = ++m_lastCheckpointId;
+    m_checkpoints.back().tick = m_tick;
+    m_newestCheckpoint = m_lastCheckpointId;
+    TrimCheckpoints();
+    return m_newestCheckpoint;
+}
+
+// Restores each chunk from the oldest copy at or after the checkpoint;
+// chunks no checkpoint saved have not changed since.
+bool World::RestoreCheckpoint(uint64_t id) {
+    auto found = std::find_if(m_checkpoints.begin(), m_checkpoints.end(),
+                              [id](const Checkpoint& checkpoint) { return checkpoint.id == id; });
+    if (found == m_checkpoints.end()) {
+        return false;
+    }
+
+    // Sparse chunks are allocated before the parallel copy, so storage
+    // does not move under it
+    std::unordered_set<uint64_t> restored;
+    m_restoreChunks.clear();
+    for (auto checkpoint = found; checkpoint != m_checkpoints.end(); ++checkpoint) {
+        for (const auto& entry : checkpoint->chunks) {
+            m_checkpointBytes -= SavedBytes(entry.second);
+            if (!restored.insert(entry.first).second) {
+                continue;
+            }
+            const SavedChunk& saved = entry.second;
+            int chunkX = static_cast<int>(static_cast<uint32_t>(entry.first));
+            int chunkY = static_cast<int>(entry.first >> 32);
+            int chunk = FindChunk(chunkX, chunkY);
+            if (chunk >= 0 && m_chunks[chunk].changeStamp.value.load(std::memory_order_relaxed) == saved.changeStamp) {
+                // Saved ahead of the passes but never written since
+                continue;
+            }
+            if (chunk < 0) {
+                // Unallocated sparse chunks already hold the air they were saved with
+                int air = saved.counts[static_cast<int>(MaterialType::Air)];
+                if (air == ChunkCellCount(chunkX, chunkY) && saved.timers.empty()) {
+                    continue;
+                }
+                chunk = EnsureChunk(chunkX, chunkY);
+            }
+            m_restoreChunks.emplace_back(chunk, &saved);
+        }
+    }
+
+    std::sort(m_restoreChunks.begin(), m_restoreChunks.end(), [this](const auto& a, const auto& b) {
+        const Chunk& first = m_chunks[a.first];
+        const Chunk& second = m_chunks[b.first];
+        return first.chunkY != second.chunkY ? first.chunkY < second.chunkY : first.chunkX < second.chunkX;
+    });
+    m_restoreRows.clear();
+    for (size_t i = 0; i < m_restoreChunks.size(); i++) {
+        if (i == 0 || m_chunks[m_restoreChunks[i].first].chunkY != m_chunks[m_restoreChunks[i - 1].first].chunkY) {
+            m_restoreRows.push_back(i);
+        }
+    }
+    m_restoreRows.push_back(m_restoreChunks.size());
+    m_threadPool->ParallelFor(static_cast<int>(m_restoreRows.size()) - 1, [this](int row) {
+        RestoreChunkRow(m_restoreRows[row], m_restoreRows[row + 1]);
+    });
+    for (const auto& entry : m_restoreChunks) {
+        Chunk& owner = m_chunks[entry.first];
+        int x0 = owner.chunkX * CHUNK_SIZE;
+        int y0 = owner.chunkY * CHUNK_SIZE;
+        int x1 = std::min(x0 + CHUNK_SIZE, m_width) - 1;
+        int y1 = std::min(y0 + CHUNK_SIZE, m_height) - 1;
+        // Timers resume with the ticks they had left at the checkpoint
+        for (const auto& timer : entry.second->timers) {
+            StartTimer(x0 + timer.first % CHUNK_SIZE, y0 + timer.first / CHUNK_SIZE,
+                       std::max(timer.second, 1));
+        }
+        // The chunk's flags were cleared with its lanes, so only its rect
+        // and the ring of cells around it are left to wake
+        owner.changed.Include(x0, y0, x1, y1);
+        owner.changeStamp.value.store(m_changeStamp, std::memory_order_relaxed);
+        MarkDirty(x0 - 1, y0 - 1, x1 + 1, y0 - 1);
+        MarkDirty(x0 - 1, y1 + 1, x1 + 1, y1 + 1);
+        MarkDirty(x0 - 1, y0, x0 - 1, y1);
+        MarkDirty(x1 + 1, y0, x1 + 1, y1);
+    }
+    m_restoreChunks.clear();
+
+    m_checkpoints.erase(found, m_checkpoints.end());
+    m_newestCheckpoint = m_checkpoints.empty() ? 0 : m_checkpoints.back().id;
+    return true;
+}
+
+// The next older checkpoint inherits the copies it relies on.
+void World::ReleaseCheckpoint(uint64_t id) {
+    auto found = std::find_if(m_checkpoints.begin(), m_checkpoints.end(),
+                              [id](const Checkpoint& checkpoint) { return checkpoint.id == id; });
+    if (found == m_checkpoints.end()) {
+        return;
+    }
+    for (auto& entry : found->chunks) {
+        // Copies the older checkpoint already holds, or that no checkpoint
+        // relies on any more, are freed
+        size_t bytes = SavedBytes(entry.second);
+        bool inherited = found != m_checkpoints.begin() &&
+                         std::prev(found)->chunks.emplace(entry.first, std::move(entry.second)).second;
+        if (!inherited) {
+            m_checkpointBytes -= bytes;
+        }
+    }
+    m_checkpoints.erase(found);
+    m_newestCheckpoint = m_checkpoints.empty() ? 0 : m_checkpoints.back().id;
+}
+
+bool World::HasCheckpoint(uint64_t id) const {
+    return std::any_of(m_checkpoints.begin(), m_checkpoints.end(),
+                       [id](const Checkpoint& checkpoint) { return checkpoint.id == id; });
+}
+
+void World::SetCheckpointBudget(size_t bytes) {
+    m_checkpointBudget = bytes;
+    TrimCheckpoints();
+}
+
+// Checkpoints are only dropped between updates, so the passes never see
+// the list change under them.
+void World::TrimCheckpoints() {
+    while (m_checkpointBytes > m_checkpointBudget && m_checkpoints.size() > 1) {
+        ReleaseCheckpoint(m_checkpoints.front().id);
+    }
+}
+
+size_t World::GetCheckpointChunkCount() const {
+    size_t count = 0;
+    for (const Checkpoint& checkpoint : m_checkpoints) {
+        count += checkpoint.chunks.size();
+    }
+    return count;
+}
+
+// Outside the passes the lock is uncontended. A sparse chunk released and
+// allocated again keeps the copy it was first saved with.
+void World::SaveChunk(int chunk) {
+    std::lock_guard<std::mutex> lock(m_checkpointLock);
+    Chunk& owner = m_chunks[chunk];
+    if (owner.checkpoint.value.load(std::memory_order_relaxed) == m_newestCheckpoint) {
+        return;
+    }
+
+    Checkpoint& checkpoint = m_checkpoints.back();
+    auto inserted = checkpoint.chunks.try_emplace(ChunkKey(owner.chunkX, owner.chunkY));
+    if (inserted.second) {
+        SavedChunk& saved = inserted.first->second;
+        int x0 = owner.chunkX * CHUNK_SIZE;
+        int y0 = owner.chunkY * CHUNK_SIZE;
+        int width = std::min(CHUNK_SIZE, m_width - x0);
+        int height = std::min(CHUNK_SIZE, m_height - y0);
+        saved.cells.assign(CHUNK_CELLS, MaterialType::Air);
+        for (int y = 0; y < height; y++) {
+            size_t row = ChunkCellIndex(chunk, x0, y0 + y);
+            std::copy(&m_pixels[row], &m_pixels[row] + width, &saved.cells[y * CHUNK_SIZE]);
+            for (int x = 0; x < width; x++) {
+                if (m_velocityX[row + x] != 0 || m_velocityY[row + x] != 0) {
+                    saved.velocities.push_back({static_cast<uint16_t>(y * CHUNK_SIZE + x), m_velocityX[row + x],
+                                                m_velocityY[row + x]});
+                }
+                if (m_flags[row + x] & CELL_TIMED) {
+                    int ticks = static_cast<uint16_t>(m_timerTick[row + x] - static_cast<uint16_t>(checkpoint.tick));
+                    saved.timers.emplace_back(y * CHUNK_SIZE + x, ticks);
+                }
+            }
+        }
+        for (int m = 0; m < MATERIAL_COUNT; m++) {
+            saved.counts[m] = owner.materialCounts[m].value.load(std::memory_order_relaxed);
+        }
+        saved.contentHash = owner.contentHash.value.load(std::memory_order_relaxed);
+        saved.changeStamp = owner.changeStamp.value.load(std::memory_order_relaxed);
+        m_checkpointBytes += SavedBytes(saved);
+    }
+    owner.checkpoint.value.store(m_newestCheckpoint, std::memory_order_release);
+}
+
+// Materials that fall as powder, as a MaterialSetMask set.
+static constexpr uint32_t PowderMaterials() {
+    uint32_t materials = 0;
+    for (int m = 0; m < MATERIAL_COUNT; m++) {
+        if (MATERIAL_PROPERTIES[m].behavior == MaterialBehavior::Powder) {
+            materials |= 1u << m;
+        }
+    }
+    return materials;
+}
+
+static constexpr uint32_t POWDER_MATERIALS = PowderMaterials();
+
+void World::RestoreChunkRow(size_t first, size_t last) {
+    int y0 = m_chunks[m_restoreChunks[first].first].chunkY * CHUNK_SIZE;
+    int height = std::min(CHUNK_SIZE, m_height - y0);
+    for (int y = 0; y < height; y++) {
+        for (size_t i = first; i < last; i++) {
+            int chunk = m_restoreChunks[i].first;
+            int x0 = m_chunks[chunk].chunkX * CHUNK_SIZE;
+            int width = std::min(CHUNK_SIZE, m_width - x0);
+            size_t row = ChunkCellIndex(chunk, x0, y0 + y);
+            const MaterialType* cells = &m_restoreChunks[i].second->cells[y * CHUNK_SIZE];
+            std::copy(cells, cells + width, &m_pixels[row]);
+            ResetLanes(row, width);
+            if (m_bitPlanes) {
+                // A plane word is exactly this chunk's row
+                size_t word = PlaneWord(x0, y0 + y);
+                m_emptyBits[word].store(MaterialSetMask(cells, width, 1u << static_cast<int>(MaterialType::Air)),
+                                        std::memory_order_relaxed);
+                m_powderBits[word].store(MaterialSetMask(cells, width, POWDER_MATERIALS), std::memory_order_relaxed);
+            }
+        }
+    }
+
+    for (size_t i = first; i < last; i++) {
+        const SavedChunk& saved = *m_restoreChunks[i].second;
+        int chunk = m_restoreChunks[i].first;
+        Chunk& owner = m_chunks[chunk];
+        for (const SavedVelocity& velocity : saved.velocities) {
+            size_t index = ChunkCellIndex(chunk, owner.chunkX * CHUNK_SIZE + velocity.cell % CHUNK_SIZE,
+                                          owner.chunkY * CHUNK_SIZE + velocity.cell / CHUNK_SIZE);
+            m_velocityX[index] = velocity.x;
+            m_velocityY[index] = velocity.y;
+        }
+        for (int m = 0; m < MATERIAL_COUNT; m++) {
+            owner.materialCounts[m].value.store(saved.counts[m], std::memory_order_relaxed);
+        }
+        owner.contentHash.value.store(saved.contentHash, std::memory_order_relaxed);
+    }
 }
 
 void World::Print() const {
@@ -61,6 +1885,15 @@ void World::Print() const {
                 case MaterialType::Stone:
                     std::cout << "#";
                     break;
+                case MaterialType::Steam:
+                    std::cout << "'";
+                    break;
+                case MaterialType::Lava:
+                    std::cout << "*";
+                    break;
+                case MaterialType::Fire:
+                    std::cout << "^";
+                    break;
             }
         }
         std::cout << "\n";
@@ -72,75 +1905,206 @@ bool World::InBounds(int x, int y) const {
     return x >= 0 && x < m_width && y >= 0 && y < m_height;
 }
 
-void World::UpdatePixel(int x, int y) {
-    MaterialType current = GetPixel(x, y);
-    
-    if (current == MaterialType::Air || current == MaterialType::Stone) {
-        return;
+template <typename Cells>
+bool World::UpdatePixel(int x, int y, const Cells& cells) {
+    size_t index = cells.Index(x, y);
+    MaterialType material = m_pixels[index];
+    KernelFn<Cells> kernel = KERNELS<Cells>[static_cast<int>(material)];
+    uint8_t flags = m_flags[index];
+
+    // A cell that already moved this tick may have landed ahead of the
+    // scan (sideways, or in a chunk of a later pass); it must not move again.
+    if (kernel == nullptr || (flags & CELL_MOVED)) {
+        return false;
     }
-    
-    const MaterialProperties& props = MATERIAL_PROPERTIES[static_cast<int>(current)];
-    
-    if (current == MaterialType::Sand) {
-        MaterialType below = GetPixel(x, y + 1);
-        
-        if (below == MaterialType::Air || 
-            (below == MaterialType::Water && MATERIAL_PROPERTIES[static_cast<int>(below)].density < props.density)) {
-            SwapPixels(x, y, x, y + 1);
-            return;
-        }
-        
-        int dir = (rand() % 2) * 2 - 1;
-        MaterialType diag1 = GetPixel(x + dir, y + 1);
-        if (diag1 == MaterialType::Air || 
-            (diag1 == MaterialType::Water && MATERIAL_PROPERTIES[static_cast<int>(diag1)].density < props.density)) {
-            SwapPixels(x, y, x + dir, y + 1);
-            return;
-        }
-        
-        MaterialType diag2 = GetPixel(x - dir, y + 1);
-        if (diag2 == MaterialType::Air || 
-            (diag2 == MaterialType::Water && MATERIAL_PROPERTIES[static_cast<int>(diag2)].density < props.density)) {
-            SwapPixels(x, y, x - dir, y + 1);
+
+    if ((flags & CELL_REST_MASK) == CELL_ASLEEP) {
+        return false;
+    }
+
+    (this->*kernel)(x, y, cells);
+
+    // Kernels only swap with other materials, so an unchanged cell stayed
+    // put. Its neighbourhood is unchanged too, or it would have been woken.
+    if (m_pixels[index] == material) {
+        m_flags[index] = flags + CELL_REST_ONE;
+    }
+    return true;
+}
+
+template <MaterialType M, typename Cells>
+void World::UpdateKernel(int x, int y, const Cells& cells) {
+    constexpr MaterialProperties props = MATERIAL_PROPERTIES[static_cast<int>(M)];
+    constexpr const uint8_t* displaces = DISPLACEMENT_TABLE.canDisplace[static_cast<int>(M)];
+    static_assert(props.behavior != MaterialBehavior::Static, "Static materials have no kernel");
+
+    if constexpr (props.behavior == MaterialBehavior::Gas) {
+        // Gases mirror liquids: up, then diagonally up, then sideways
+        constexpr const uint8_t* rises = DISPLACEMENT_TABLE.canRise[static_cast<int>(M)];
+        int dir = (CellRandom(m_tickRandomKey, x, y) & 1) * 2 - 1;
+        const int moves[5][2] = {{0, -1}, {dir, -1}, {-dir, -1}, {dir, 0}, {-dir, 0}};
+        for (const auto& move : moves) {
+            if (rises[static_cast<int>(cells.Cell(x + move[0], y + move[1]))]) {
+                SwapCells(cells, x, y, x + move[0], y + move[1]);
+                return;
+            }
         }
+        return;
     }
-    else if (current == MaterialType::Water) {
-        MaterialType below = GetPixel(x, y + 1);
-        
+
+    MaterialType below = cells.Cell(x, y + 1);
+    if (displaces[static_cast<int>(below)]) {
+        int velocity = m_velocityY[cells.Index(x, y)];
+        int distance = 1;
         if (below == MaterialType::Air) {
-            SwapPixels(x, y, x, y + 1);
-            return;
-        }
-        
-        int dir = (rand() % 2) * 2 - 1;
-        
-        MaterialType diag1 = GetPixel(x + dir, y + 1);
-        if (diag1 == MaterialType::Air) {
-            SwapPixels(x, y, x + dir, y + 1);
-            return;
-        }
-        
-        MaterialType diag2 = GetPixel(x - dir, y + 1);
-        if (diag2 == MaterialType::Air) {
-            SwapPixels(x, y, x - dir, y + 1);
-            return;
+            int reach = std::clamp(1 + velocity / FALL_VELOCITY_PER_CELL, 1, MAX_FALL_DISTANCE);
+            while (distance < reach && cells.Cell(x, y + distance + 1) == MaterialType::Air) {
+                distance++;
+            }
+            velocity = std::clamp(velocity + 1, 1, MAX_FALL_VELOCITY);
+        } else {
+            // Sinking into a lighter material is slow and carries no speed
+            velocity = 0;
         }
-        
-        MaterialType side1 = GetPixel(x + dir, y);
-        if (side1 == MaterialType::Air) {
-            SwapPixels(x, y, x + dir, y);
+        SwapCells(cells, x, y, x, y + distance);
+        m_velocityY[cells.Index(x, y + distance)] = static_cast<int8_t>(velocity);
+        return;
+    }
+
+    // A cell that cannot fall straight down loses its fall speed. It may
+    // not move, so the write stamps the chunk itself.
+    size_t index = cells.Index(x, y);
+    if (m_velocityY[index] != 0) {
+        m_velocityY[index] = 0;
+        StampChunk(cells.ChunkOf(index, x, y));
+    }
+
+    int dir = (CellRandom(m_tickRandomKey, x, y) & 1) * 2 - 1;
+
+    if (displaces[static_cast<int>(cells.Cell(x + dir, y + 1))]) {
+        SwapCells(cells, x, y, x + dir, y + 1);
+        return;
+    }
+
+    if (displaces[static_cast<int>(cells.Cell(x - dir, y + 1))]) {
+        SwapCells(cells, x, y, x - dir, y + 1);
+        return;
+    }
+
+    if constexpr (props.behavior == MaterialBehavior::Liquid) {
+        if (displaces[static_cast<int>(cells.Cell(x + dir, y))]) {
+            SwapCells(cells, x, y, x + dir, y);
             return;
         }
-        
-        MaterialType side2 = GetPixel(x - dir, y);
-        if (side2 == MaterialType::Air) {
-            SwapPixels(x, y, x - dir, y);
+
+        if (displaces[static_cast<int>(cells.Cell(x - dir, y))]) {
+            SwapCells(cells, x, y, x - dir, y);
         }
     }
 }
 
+template <MaterialType M, typename Cells>
+constexpr World::KernelFn<Cells> World::KernelFor() {
+    if constexpr (MATERIAL_PROPERTIES[static_cast<int>(M)].behavior == MaterialBehavior::Static) {
+        return nullptr;
+    } else {
+        return &World::UpdateKernel<M, Cells>;
+    }
+}
+
+template <typename Cells, size_t... M>
+constexpr std::array<World::KernelFn<Cells>, sizeof...(M)> World::BuildKernels(std::index_sequence<M...>) {
+    return {{KernelFor<static_cast<MaterialType>(M), Cells>()...}};
+}
+
+template <typename Cells>
+constexpr std::array<World::KernelFn<Cells>, MATERIAL_COUNT> World::KERNELS =
+    BuildKernels<Cells>(std::make_index_sequence<MATERIAL_COUNT>());
+
 void World::SwapPixels(int x1, int y1, int x2, int y2) {
-    if (InBounds(x1, y1) && InBounds(x2, y2)) {
-        std::swap(m_pixels[y1 * m_width + x1], m_pixels[y2 * m_width + x2]);
+    size_t from = Index(x1, y1);
+    size_t to = Index(x2, y2);
+    int fromChunk = m_sparse ? m_blockChunks[from / CHUNK_CELLS] : ChunkIndex(x1, y1);
+    int toChunk = m_sparse ? m_blockChunks[to / CHUNK_CELLS] : ChunkIndex(x2, y2);
+    SwapCells(x1, y1, from, fromChunk, x2, y2, to, toChunk);
+}
+
+void World::SwapCells(int x1, int y1, size_t from, int fromChunk, int x2, int y2, size_t to, int toChunk) {
+    PreserveChunk(fromChunk);
+    PreserveChunk(toChunk);
+    std::swap(m_pixels[from], m_pixels[to]);
+    std::swap(m_flags[from], m_flags[to]);
+    SwapLanes(from, to);
+
+    if (m_pixels[from] != m_pixels[to]) {
+        // Each cell's key changes from one material's to the other's
+        int64_t fromId = CellId(x1, y1);
+        int64_t toId = CellId(x2, y2);
+        uint64_t fromKeys = CellKey(fromId, m_pixels[from]) ^ CellKey(fromId, m_pixels[to]);
+        uint64_t toKeys = CellKey(toId, m_pixels[from]) ^ CellKey(toId, m_pixels[to]);
+        if (fromChunk != toChunk) {
+            CountMaterial(fromChunk, m_pixels[to], m_pixels[from]);
+            CountMaterial(toChunk, m_pixels[from], m_pixels[to]);
+            XorContentHash(fromChunk, fromKeys);
+            XorContentHash(toChunk, toKeys);
+        } else {
+            XorContentHash(fromChunk, fromKeys ^ toKeys);
+        }
+    }
+
+    // The moving cell starts inside the chunk being updated, so only
+    // that chunk's task ever appends to its list. A displaced cell that
+    // had already moved keeps its mark and is recorded again, and a timed
+    // one is recorded so FinishMoves reschedules it at its new position.
+    std::vector<size_t>& moved = m_chunks[fromChunk].moved;
+    m_flags[to] |= CELL_MOVED;
+    moved.push_back(to);
+    if (m_flags[from] & (CELL_MOVED | CELL_TIMED)) {
+        moved.push_back(from);
+    }
+
+    if (m_bitPlanes) {
+        SyncBitPlanes(x1, y1);
+        SyncBitPlanes(x2, y2);
+    }
+
+    MarkDirty(x1, y1);
+    MarkDirty(x2, y2);
+}
+
+void World::MarkDirty(int x, int y) {
+    // A change can unblock any neighbouring cell, so the 3x3 neighbourhood
+    // is marked dirty and woken.
+    MarkDirty(x - 1, y - 1, x + 1, y + 1);
+}
+
+void World::MarkDirty(int x0, int y0, int x1, int y1) {
+    // The area is added to the dirty rect of every chunk that owns part of it
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, m_width - 1);
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, m_height - 1);
+
+    for (int cy = y0 / CHUNK_SIZE; cy <= y1 / CHUNK_SIZE; cy++) {
+        int chunkY0 = std::max(y0, cy * CHUNK_SIZE);
+        int chunkY1 = std::min(y1, cy * CHUNK_SIZE + CHUNK_SIZE - 1);
+        for (int cx = x0 / CHUNK_SIZE; cx <= x1 / CHUNK_SIZE; cx++) {
+            // Unallocated sparse chunks hold only air, which never needs waking
+            int chunk = m_sparse ? FindChunk(cx, cy) : cy * m_chunksX + cx;
+            if (chunk < 0) {
+                continue;
+            }
+            int chunkX0 = std::max(x0, cx * CHUNK_SIZE);
+            int chunkX1 = std::min(x1, cx * CHUNK_SIZE + CHUNK_SIZE - 1);
+            m_chunks[chunk].changed.Include(chunkX0, chunkY0, chunkX1, chunkY1);
+            m_chunks[chunk].changeStamp.value.store(m_changeStamp, std::memory_order_relaxed);
+
+            for (int y = chunkY0; y <= chunkY1; y++) {
+                uint8_t* row = &m_flags[ChunkCellIndex(chunk, chunkX0, y)];
+                for (int x = 0; x <= chunkX1 - chunkX0; x++) {
+                    row[x] &= ~CELL_REST_MASK;
+                }
+            }
+        }
     }
 }
\ No newline at end of file
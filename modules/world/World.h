@@ -1,31 +1,625 @@
 #pragma once
 
 #include "../materials/Materials.h"
+#include "../core/AlignedAllocator.h"
+#include "ParticleSystem.h"
+#include "TimingWheel.h"
+#include "../simulation/ScalarField.h"
 #include <vector>
+#include <array>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
+#include <cstddef>
+#include <climits>
+
+class ThreadPool;
+
+// Dense worlds store every cell. Sparse worlds only store chunks that hold
+// something other than air, so huge, mostly empty maps stay small.
+enum class WorldStorage {
+    Dense,
+    Sparse
+};
 
 class World {
 public:
-    World(int width, int height);
-    ~World() = default;
+    // Side length of the square chunks the grid is partitioned into. A
+    // chunk row is scanned as a single 64-bit mask, so this must stay <= 64.
+    // Chunks are updated in four checkerboard passes; a cell may move at
+    // most CHUNK_SIZE / 2 cells per tick so that chunks updated in the
+    // same pass never touch each other's cells.
+    static constexpr int CHUNK_SIZE = 64;
+
+    // Every this many ticks, liquid bodies touching awake chunks are levelled
+    // by moving their highest surface cells straight to the lowest free
+    // cells around the body. Zero disables levelling.
+    static constexpr int DEFAULT_LEVELING_INTERVAL = 8;
+
+    // Heat of places that have never been heated or cooled.
+    static constexpr int AMBIENT_TEMPERATURE = 20;
+
+    // Scalar fields are stored at one sample per FIELD_CELL_SIZE squared
+    // cells. The heat field always exists and drives PHASE_CHANGES.
+    static constexpr int FIELD_CELL_SIZE = 4;
+    static constexpr const char* HEAT_FIELD = "heat";
+
+    // In sparse storage a chunk is allocated on the first write to it and
+    // released once it is all air and it and its neighbours are asleep.
+    // Scalar fields and powder bit planes are only available in dense
+    // storage; see GetFields and SetPowderBitPlanes.
+    World(int width, int height, WorldStorage storage = WorldStorage::Dense);
+    ~World();
 
     void Update();
+
+    // Number of threads (including the caller) used by Update. The pool is
+    // persistent, so changing this is the only time threads are created.
+    void SetThreadCount(int threadCount);
+    int GetThreadCount() const;
+
+    void SetLevelingInterval(int ticks) { m_levelingInterval = ticks; }
+    int GetLevelingInterval() const { return m_levelingInterval; }
+
+    // Randomness in the simulation is a hash of (seed, tick, x, y), so a
+    // seed fully determines a run regardless of thread count.
+    void SetSeed(uint64_t seed);
+    uint64_t GetSeed() const { return m_seed; }
+    uint64_t GetTick() const { return m_tick; }
+    // Zobrist hash of every cell's material: the XOR of a key per non-air
+    // cell and its position, which every write keeps current per chunk.
+    // Equal contents hash equal whatever the storage, so comparing worlds
+    // or checking for changes costs O(chunks) rather than O(cells).
+    uint64_t GetContentHash() const;
+    uint64_t GetChunkContentHash(int chunkX, int chunkY) const;
+    // Content hash combined with the tick, the velocity and timer lanes of
+    // non-air cells, the heat field and the particles in flight, taken at
+    // the end of each Update. Identical runs hash identically every tick
+    // whatever their thread count. Lanes are rehashed only for chunks that
+    // were updated or written since the last hash. Heat is hashed by the
+    // samples that differ from ambient, so a field at rest hashes like the
+    // missing field of a sparse world.
+    uint64_t GetStateHash() const { return m_stateHash; }
     void SetPixel(int x, int y, MaterialType material);
     MaterialType GetPixel(int x, int y) const;
-    
+
+    // Bulk writes with the same effect as SetPixel on every cell they
+    // change. The area is clipped once and written a chunk row span at a
+    // time, with counts, hashes and bit planes updated per span and the
+    // changed area woken by a single MarkDirty. Corners are inclusive.
+    void FillRect(int x0, int y0, int x1, int y1, MaterialType material);
+    // Cells with dx * dx + dy * dy <= radius * radius.
+    void FillCircle(int centerX, int centerY, int radius, MaterialType material);
+    // Pastes a row-major grid of cells with its top-left corner at (x, y).
+    // With a mask, only cells whose mask entry is non-zero are written.
+    void Blit(int x, int y, int width, int height, const MaterialType* cells, size_t stride,
+              const uint8_t* mask = nullptr);
+    // Pastes the part of a region of source, which may be this world,
+    // that lies inside source.
+    void Blit(const World& source, int sourceX, int sourceY, int width, int height, int x, int y);
+    // Copies a region into a row-major grid; cells outside the world read
+    // as Stone, like GetPixel.
+    void CopyRegion(int x, int y, int width, int height, MaterialType* out, size_t stride) const;
+
+    // Per-cell lanes beside the material, each in its own aligned array:
+    // velocity, which falling cells use, and the timer below. Values travel
+    // with their cell when it moves and are reset by SetPixel. Temperature
+    // is not a lane; it is the heat field, read with GetHeat.
+    void SetVelocity(int x, int y, int velocityX, int velocityY);
+    int GetVelocityX(int x, int y) const;
+    int GetVelocityY(int x, int y) const;
+
+    // Timers turn a cell into its TIMED_TRANSITIONS expired material after
+    // the given number of ticks, up to MAX_TIMER_TICKS; zero cancels. The
+    // timer travels with the cell and is dropped when the cell is replaced.
+    // Only timers that come due cost anything in Update.
+    static constexpr int MAX_TIMER_TICKS = UINT16_MAX;
+    void SetTimer(int x, int y, int ticks);
+    // Ticks left on the cell's timer, or zero if it has none.
+    int GetTimer(int x, int y) const;
+    size_t GetTimersDueLastUpdate() const { return m_timersDue; }
+
     int GetWidth() const { return m_width; }
     int GetHeight() const { return m_height; }
 
+    int GetChunkCountX() const { return m_chunksX; }
+    int GetChunkCountY() const { return m_chunksY; }
+    bool IsChunkAwake(int chunkX, int chunkY) const;
+    bool IsSparse() const { return m_sparse; }
+    // Chunks with cell storage; every chunk in a dense world.
+    size_t GetAllocatedChunkCount() const { return m_chunks.size(); }
+    // Chunk blocks of cell storage, including released blocks kept for
+    // reuse; never fewer than the allocated chunks. Sparse storage gives
+    // released blocks back once few of its blocks are in use.
+    size_t GetStorageBlockCount() const { return m_sparse ? m_blockChunks.size() - 1 : m_chunks.size(); }
+    // Bytes held by cell storage and its lanes.
+    size_t GetStorageBytes() const;
+
+    // Number of cells inside the dirty rectangles visited by the last Update.
+    size_t GetCellsScannedLastUpdate() const { return m_cellsScanned; }
+    // Number of cells whose update kernel ran during the last Update.
+    size_t GetCellsUpdatedLastUpdate() const { return m_cellsUpdated; }
+    // Number of cells checked for REACTIONS during the last Update.
+    size_t GetCellsReactionCheckedLastUpdate() const { return m_cellsReactionChecked; }
+    // Cells of a material inside a chunk, kept current by every write.
+    int GetChunkMaterialCount(int chunkX, int chunkY, MaterialType material) const;
+
+    // Level of detail. With no focus rects every chunk updates every tick.
+    // Otherwise chunks overlapping a focus rect update every tick, chunks
+    // within the focus margin (in chunks) every second tick, and the rest
+    // every distant interval ticks, or never when it is zero. Skipped
+    // ticks with pending work are replayed, CATCH_UP_ROUNDS per tick, once
+    // a chunk is back in focus. Reactions belong to a chunk's update, so
+    // they are deferred and replayed with its movement; fields, particles
+    // and timers are not deferred.
+    static constexpr int DEFAULT_FOCUS_MARGIN = 2;
+    static constexpr int DEFAULT_DISTANT_INTERVAL = 8;
+    static constexpr int CATCH_UP_ROUNDS = 2;
+    static constexpr int MAX_CATCH_UP_TICKS = 64;
+    void AddFocusRect(int x0, int y0, int x1, int y1);
+    void ClearFocusRects() { m_focusRects.clear(); }
+    void SetFocusMargin(int chunks) { m_focusMargin = chunks; }
+    void SetDistantInterval(int ticks) { m_distantInterval = ticks; }
+    // Ticks between updates of a chunk under the current focus; zero if frozen.
+    int GetChunkUpdateInterval(int chunkX, int chunkY) const;
+    // Chunks with pending work that the last Update skipped.
+    size_t GetChunksDeferredLastUpdate() const { return m_chunksDeferred; }
+
+    // Change stamps let readers copy only the chunks that changed. Update
+    // advances the world's stamp on entry and on exit, as does
+    // TakeCheckpoint, and every write records the current stamp on its
+    // chunk, so a chunk may differ from a copy taken at stamp S only if its
+    // own stamp is at least S.
+    uint64_t GetChangeStamp() const { return m_changeStamp; }
+    uint64_t GetChunkChangeStamp(int chunkX, int chunkY) const;
+    // Copies a chunk's cells into a row-major grid with the given row
+    // stride; out points at the grid cell of the chunk's top-left corner.
+    void CopyChunkCells(int chunkX, int chunkY, MaterialType* out, size_t stride) const;
+
+    // Optional bit planes (one bit per cell, one 64-bit word per chunk row)
+    // marking empty and powder cells. When enabled, straight-down powder
+    // falls for a whole chunk row are found and moved with word operations
+    // before the per-cell kernels handle diagonal slides and liquids.
+    void SetPowderBitPlanes(bool enabled);
+    bool HasPowderBitPlanes() const { return m_bitPlanes; }
+
+    // Free-flight particles, stepped at the end of every Update. Landed
+    // particles are written back with SetPixel.
+    ParticleSystem& GetParticles() { return m_particles; }
+    const ParticleSystem& GetParticles() const { return m_particles; }
+    // Lifts a cell out of the grid as a particle; false if the cell is Air
+    // or the particle pool is full.
+    bool EjectPixel(int x, int y, float velocityX, float velocityY);
+
+    // Fields are stepped once per Update after the cells move. Then cells in
+    // hot samples turn into PHASE_CHANGES' hotter phase and cells in cold
+    // ones into their colder phase, whether or not they are awake.
+    // Sparse worlds have no fields, since a field covers the whole world:
+    // their heat reads as ambient and AddHeat returns false, so only
+    // reactions that release heat play out differently in the two modes.
+    bool HasFields() const { return m_heat != nullptr; }
+    FieldSet& GetFields() { return m_fields; }
+    const FieldSet& GetFields() const { return m_fields; }
+    float GetHeat(int x, int y) const;
+    // False if the cell is outside the world or the world has no fields.
+    bool AddHeat(int x, int y, float amount);
+
     void Clear();
     void Print() const;
 
+    // Copy-on-write checkpoints for undo. Taking one is O(1); the first
+    // write to a chunk afterwards saves that chunk into the newest
+    // checkpoint, so memory and restore time grow with the chunks changed
+    // since, not with the world. Every write counts, the simulation's too.
+    // Restoring puts back every cell's material, velocity and timer, which
+    // rewinds everything that happened in the world since; cells restart
+    // their rest counts as if just placed, and particles and fields are
+    // left as they are. Restoring drops the checkpoint and every newer one.
+    // Ids are never reused; 0 is none.
+    // Only saving is copy-on-write. Chunks have no storage of their own to
+    // swap back, since dense chunks are windows of one grid and sparse
+    // blocks are slots of one array, so restoring copies each saved chunk
+    // back row by row, spread over the thread pool. Saved chunks whose
+    // change stamp has not moved since are skipped, so every lane write
+    // stamps its chunk. The budget below caps the copy; undoing a clear of
+    // a full 4096 x 4096 world restores 16 MiB of cells, about 30 ms on
+    // one core.
+    uint64_t TakeCheckpoint();
+    bool RestoreCheckpoint(uint64_t id);
+    void ReleaseCheckpoint(uint64_t id);
+    bool HasCheckpoint(uint64_t id) const;
+    size_t GetCheckpointCount() const { return m_checkpoints.size(); }
+    // Chunk copies held by all checkpoints.
+    size_t GetCheckpointChunkCount() const;
+    // Once the copies held take more than the budget, the oldest
+    // checkpoints are dropped when the next one is taken or the next Update
+    // ends, until they fit or only the newest is left.
+    static constexpr size_t DEFAULT_CHECKPOINT_BUDGET = 64u << 20;
+    void SetCheckpointBudget(size_t bytes);
+    size_t GetCheckpointBudget() const { return m_checkpointBudget; }
+    size_t GetCheckpointBytes() const { return m_checkpointBytes; }
+
 private:
+    // Per-cell flag bits kept in m_flags, parallel to m_pixels. Flags are
+    // only read for movable cells, so scans over inert cells never touch them.
+    static constexpr uint8_t CELL_MOVED = 1 << 0;  // moved during this tick
+    // Ticks in a row the cell's kernel ran without moving it. At
+    // CELL_ASLEEP the kernel is skipped until a change in the 3x3
+    // neighbourhood wakes the cell again.
+    static constexpr uint8_t CELL_REST_ONE = 1 << 1;
+    static constexpr uint8_t CELL_REST_MASK = 3 << 1;
+    static constexpr uint8_t CELL_ASLEEP = CELL_REST_MASK;
+    static constexpr uint8_t CELL_LEVELED = 1 << 3;  // seen by this levelling pass
+    static constexpr uint8_t CELL_TIMED = 1 << 4;    // m_timerTick holds a live timer
+
+    // A cell falling through air gains one unit of vertical velocity per
+    // tick and drops 1 + velocity / FALL_VELOCITY_PER_CELL rows, walking
+    // down the column and stopping above the first cell that is not air.
+    static constexpr int FALL_VELOCITY_PER_CELL = 4;
+    static constexpr int MAX_FALL_DISTANCE = CHUNK_SIZE / 2;
+    static constexpr int MAX_FALL_VELOCITY = (MAX_FALL_DISTANCE - 1) * FALL_VELOCITY_PER_CELL;
+
+    // Inclusive bounds in world coordinates; empty when minX > maxX.
+    struct DirtyRect {
+        int minX = INT_MAX;
+        int minY = INT_MAX;
+        int maxX = INT_MIN;
+        int maxY = INT_MIN;
+
+        bool IsEmpty() const { return minX > maxX; }
+        void Include(int x0, int y0, int x1, int y1);
+        void Include(const DirtyRect& other);
+    };
+
+    // Dirty rect that chunks updated in parallel can grow concurrently.
+    // Copies are only made between updates, when chunks are added or
+    // removed.
+    struct AtomicDirtyRect {
+        std::atomic<int> minX{INT_MAX};
+        std::atomic<int> minY{INT_MAX};
+        std::atomic<int> maxX{INT_MIN};
+        std::atomic<int> maxY{INT_MIN};
+
+        AtomicDirtyRect() = default;
+        AtomicDirtyRect(const AtomicDirtyRect& other) { *this = other; }
+        AtomicDirtyRect& operator=(const AtomicDirtyRect& other);
+        bool IsEmpty() const { return minX.load(std::memory_order_relaxed) > maxX.load(std::memory_order_relaxed); }
+        void Include(int x0, int y0, int x1, int y1);
+        DirtyRect Take();
+    };
+
+    // Relaxed atomic value with the same copy rule as AtomicDirtyRect.
+    template <typename T>
+    struct RelaxedAtomic {
+        std::atomic<T> value{0};
+
+        RelaxedAtomic() = default;
+        RelaxedAtomic(const RelaxedAtomic& other) : value(other.value.load(std::memory_order_relaxed)) {}
+        RelaxedAtomic& operator=(const RelaxedAtomic& other) {
+            value.store(other.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return *this;
+        }
+    };
+
+    // Chunks only carry bookkeeping; cell data stays in m_pixels.
+    // Each tick a chunk visits only the cells around changes made during
+    // the previous two ticks, and sleeps once that area is empty.
+    struct Chunk {
+        int chunkX = 0;
+        int chunkY = 0;
+        DirtyRect rect;         // cells visited this tick
+        AtomicDirtyRect changed; // grown by changes made this tick
+        DirtyRect lastChanged;  // changes made during the previous tick
+        std::vector<size_t> moved; // cells this chunk's update marked CELL_MOVED
+        size_t updated = 0;     // kernels run by this chunk's update
+        size_t reactionChecked = 0; // cells this chunk's reaction pass checked
+        // Cells of each material; only cross-chunk moves touch other chunks
+        RelaxedAtomic<int> materialCounts[MATERIAL_COUNT];
+        RelaxedAtomic<uint64_t> changeStamp; // world change stamp of the last write
+        RelaxedAtomic<uint64_t> contentHash; // Zobrist hash of the cells
+        RelaxedAtomic<uint64_t> checkpoint;  // newest checkpoint holding a copy
+        uint64_t laneHash = 0;  // velocity and timer lanes, as of the last state hash
+        uint32_t reactive = 0;  // materials with a partner in the 3x3 chunks
+        int interval = 1;       // ticks between updates under the focus
+        int backlog = 0;        // skipped ticks still to replay
+    };
+
+    // A chunk's cells as they were when a checkpoint was taken, in rows of
+    // CHUNK_SIZE, with the velocity of each moving cell and the ticks left
+    // on each timer at that point. Most cells are at rest, so velocities
+    // are kept per cell like timers rather than as whole lanes. The
+    // chunk's material counts and content hash are kept too, so restoring
+    // never rescans the cells.
+    struct SavedVelocity {
+        uint16_t cell; // in chunk
+        int8_t x;
+        int8_t y;
+    };
+    struct SavedChunk {
+        std::vector<MaterialType> cells;
+        std::vector<SavedVelocity> velocities;
+        std::vector<std::pair<int, int>> timers; // (cell in chunk, ticks)
+        int counts[MATERIAL_COUNT] = {};
+        uint64_t contentHash = 0;
+        uint64_t changeStamp = 0; // the chunk's change stamp when it was saved
+    };
+
+    // A chunk not saved in a checkpoint was unchanged until the next
+    // checkpoint that saved it, or until now if none did.
+    struct Checkpoint {
+        uint64_t id = 0;
+        uint64_t tick = 0;
+        std::unordered_map<uint64_t, SavedChunk> chunks; // by ChunkKey
+    };
+
+    // Cells of a chunk in sparse storage, which holds one block of
+    // CHUNK_CELLS per allocated chunk after a leading block that is always
+    // air. Cells of unallocated chunks index that block, so reads see air
+    // without a branch; writes must allocate the chunk first. Released
+    // blocks are reset and reused, and storage grows by doubling. Blocks
+    // only move between updates, when CompactBlocks shrinks storage.
+    static constexpr int CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE;
+
+    // Cell addressing for the kernels, set up once per chunk update so no
+    // cell access branches on the storage mode or looks a chunk up. The
+    // kernels only reach cells of the updated chunk and its neighbours.
+    // Dense storage is indexed directly, with its ring of Stone standing
+    // in for the world's edge.
+    struct DenseCells {
+        MaterialType* pixels;
+        int stride;
+        int chunksX;
+
+        size_t Index(int x, int y) const { return static_cast<size_t>(y + 1) * stride + x + 1; }
+        MaterialType Cell(int x, int y) const { return pixels[Index(x, y)]; }
+        int ChunkOf(size_t, int x, int y) const { return (y / CHUNK_SIZE) * chunksX + x / CHUNK_SIZE; }
+    };
+
+    // Sparse storage holds the blocks of the updated chunk and its eight
+    // neighbours, which the passes allocate first. It has no ring, so
+    // cells outside the world are read as Stone through a bounds check.
+    struct SparseCells {
+        MaterialType* pixels;
+        const int* blockChunks;
+        int width;
+        int height;
+        int originX;  // first cell of the top-left neighbour
+        int originY;
+        size_t blocks[3][3]; // first storage index of each chunk's block
+
+        size_t Index(int x, int y) const {
+            int localX = x - originX;
+            int localY = y - originY;
+            return blocks[localY / CHUNK_SIZE][localX / CHUNK_SIZE] +
+                   (localY % CHUNK_SIZE) * CHUNK_SIZE + localX % CHUNK_SIZE;
+        }
+        MaterialType Cell(int x, int y) const {
+            bool inside = x >= 0 && x < width && y >= 0 && y < height;
+            return inside ? pixels[Index(x, y)] : MaterialType::Stone;
+        }
+        int ChunkOf(size_t index, int, int) const { return blockChunks[index / CHUNK_CELLS]; }
+    };
+
+    DenseCells DenseCellsOf() { return {m_pixels.data(), m_stride, m_chunksX}; }
+    SparseCells SparseCellsAround(const Chunk& chunk);
+
     bool InBounds(int x, int y) const;
-    void UpdatePixel(int x, int y);
+    // Storage index of a cell. Dense storage is row-major inside a one cell
+    // ring of Stone, so rows are m_stride long and cell (0, 0) is at
+    // m_stride + 1; sparse storage is row-major within each chunk's block.
+    // These branch on the storage mode, so the chunk passes use the Cells
+    // accessors above instead.
+    size_t Index(int x, int y) const {
+        return m_sparse ? ChunkCellIndex(FindChunk(x / CHUNK_SIZE, y / CHUNK_SIZE), x, y)
+                        : static_cast<size_t>(y + 1) * m_stride + x + 1;
+    }
+    size_t ChunkCellIndex(int chunk, int x, int y) const {
+        return m_sparse ? m_chunkBlocks[chunk + 1] * CHUNK_CELLS + (y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE
+                        : static_cast<size_t>(y + 1) * m_stride + x + 1;
+    }
+    void FillBorder();
+    void ResetBlock(size_t block);
+    // Position of m_chunks entry for a cell or chunk; -1 when the chunk is
+    // outside the world or, in sparse storage, not allocated.
+    int ChunkIndex(int x, int y) const {
+        return m_sparse ? FindChunk(x / CHUNK_SIZE, y / CHUNK_SIZE) : (y / CHUNK_SIZE) * m_chunksX + x / CHUNK_SIZE;
+    }
+    int FindChunk(int chunkX, int chunkY) const;
+    // World-wide cell id, ordered row by row in both storage modes.
+    int64_t CellId(int x, int y) const { return static_cast<int64_t>(y) * m_width + x; }
+    void CellPosition(size_t index, int& x, int& y) const;
+    static uint64_t ChunkKey(int chunkX, int chunkY) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(chunkY)) << 32) | static_cast<uint32_t>(chunkX);
+    }
+    // Sparse storage only; these must not run during the chunk passes.
+    // Storage follows the active area: it doubles when EnsureChunk runs out
+    // of blocks, and once it holds more than MIN_COMPACT_BLOCKS and over
+    // COMPACT_RATIO times the allocated chunks, CompactBlocks moves the
+    // blocks in use to the front and frees the rest. So storage never
+    // exceeds the larger of those two bounds for long.
+    static constexpr size_t MIN_COMPACT_BLOCKS = 64;
+    static constexpr size_t COMPACT_RATIO = 4;
+    int EnsureChunk(int chunkX, int chunkY);
+    void CompactBlocks();
+    // Storage index of a cell about to be written; allocates in sparse storage.
+    size_t WritableIndex(int x, int y);
+    void AllocateNeighbourChunks();
+    void ReleaseEmptyChunks();
+    void RemoveChunk(int chunk);
+    void ResizeStorage(size_t cells);
+    // Each non-static material gets its own instantiation of UpdateKernel
+    // per storage mode, reached through a table indexed by MaterialType.
+    // The table is built over every MaterialType value, so entry m is
+    // always KernelFor<m>. Materials with bespoke rules add an explicit
+    // specialization in World.cpp.
+    template <typename Cells>
+    using KernelFn = void (World::*)(int x, int y, const Cells& cells);
+    template <MaterialType M, typename Cells> void UpdateKernel(int x, int y, const Cells& cells);
+    template <MaterialType M, typename Cells> static constexpr KernelFn<Cells> KernelFor();
+    template <typename Cells, size_t... M>
+    static constexpr std::array<KernelFn<Cells>, sizeof...(M)> BuildKernels(std::index_sequence<M...>);
+    template <typename Cells>
+    static const std::array<KernelFn<Cells>, MATERIAL_COUNT> KERNELS;
+
+    // Runs task on every chunk accepted by include, in the four checkerboard
+    // passes. Chunks within a pass run in parallel.
+    void RunChunkPasses(const std::function<bool(const Chunk&)>& include,
+                        const std::function<void(Chunk&)>& task);
+    void TakeChunkRect(Chunk& chunk);
+    // Every cell write goes through this first. The chunk passes run it
+    // only on chunks RunChunkPasses has already saved, so saving itself
+    // never races the passes.
+    void PreserveChunk(int chunk) {
+        if (m_newestCheckpoint != 0 &&
+            m_chunks[chunk].checkpoint.value.load(std::memory_order_acquire) != m_newestCheckpoint) {
+            SaveChunk(chunk);
+        }
+    }
+    void SaveChunk(int chunk);
+    static size_t SavedBytes(const SavedChunk& saved) {
+        return saved.cells.size() * sizeof(MaterialType) + saved.velocities.size() * sizeof(SavedVelocity) +
+               saved.timers.size() * sizeof(saved.timers[0]);
+    }
+    void TrimCheckpoints();
+    // Puts back the cells, counts, hashes and bit plane words of
+    // m_restoreChunks[first, last), which share a row of chunks, a world
+    // row at a time so dense storage is walked in order. Rows of chunks
+    // restore in parallel; timers and waking follow serially.
+    void RestoreChunkRow(size_t first, size_t last);
+    void XorContentHash(int chunk, uint64_t keys) {
+        m_chunks[chunk].contentHash.value.fetch_xor(keys, std::memory_order_relaxed);
+    }
+    void UpdateStateHash();
+    uint64_t HashChunkLanes(int chunk) const;
+    // Records a lane write that does not go through MarkDirty
+    void StampChunk(int chunk) { m_chunks[chunk].changeStamp.value.store(m_changeStamp, std::memory_order_relaxed); }
+    bool IsChunkDue(const Chunk& chunk) const;
+    void CatchUpChunks();
+    void FinishMoves();
+    size_t UpdateChunk(Chunk& chunk);
+    template <typename Cells> size_t UpdateCells(const DirtyRect& rect, const Cells& cells);
+    // Reacts the visited cells of the chunks include accepts.
+    void React(const std::function<bool(const Chunk&)>& include);
+    template <typename Cells>
+    size_t ReactChunk(const DirtyRect& rect, uint32_t reactive, uint64_t key, const Cells& cells);
+    uint32_t ChunkMaterials(int chunkX, int chunkY) const;
+    int ChunkCellCount(int chunkX, int chunkY) const;
+    void CountMaterial(int chunk, MaterialType removed, MaterialType added);
+    void ResetMaterialCounts();
+    template <typename Cells> bool UpdatePixel(int x, int y, const Cells& cells);
+    // Writes cells[x - x0], or material when cells is null, to the row's
+    // cells x0..x1, which must be inside the world. Cells whose mask entry
+    // is zero are skipped. Grows changed by the cells that changed.
+    void WriteSpan(int y, int x0, int x1, const MaterialType* cells, MaterialType material,
+                   const uint8_t* mask, DirtyRect& changed);
+    void StartLifetimeTimer(int x, int y, MaterialType material);
+    // Both cells must be inside the world.
     void SwapPixels(int x1, int y1, int x2, int y2);
+    template <typename Cells> void SwapCells(const Cells& cells, int x1, int y1, int x2, int y2) {
+        size_t from = cells.Index(x1, y1);
+        size_t to = cells.Index(x2, y2);
+        SwapCells(x1, y1, from, cells.ChunkOf(from, x1, y1), x2, y2, to, cells.ChunkOf(to, x2, y2));
+    }
+    void SwapCells(int x1, int y1, size_t from, int fromChunk, int x2, int y2, size_t to, int toChunk);
+    void MarkDirty(int x, int y);
+    void MarkDirty(int x0, int y0, int x1, int y1);
+    void ApplyHotterPhases();
+    void ApplyColderPhases();
+    void StartTimer(int x, int y, int ticks);
+    void ExpireTimers();
+    void LevelLiquids();
+    void LevelBody(int seedX, int seedY);
+    void SwapLanes(size_t from, size_t to);
+    // Swaps the lanes of the cells from + i and to + i for each bit i of
+    // columns, for rows of count cells.
+    void SwapLanes(size_t from, size_t to, uint64_t columns, int count);
+    void ResetLanes(size_t index);
+    void ResetLanes(size_t index, int count);
+
+    // Bit planes are indexed by (row, chunk column); the bit is x % 64.
+    size_t PlaneWord(int x, int y) const { return static_cast<size_t>(y) * m_chunksX + x / CHUNK_SIZE; }
+    void RebuildBitPlanes();
+    void SyncBitPlanes(int x, int y);
+    uint64_t DropPowderRow(int chunkX, int y, uint64_t columns, uint64_t movable);
 
     int m_width;
     int m_height;
-    std::vector<MaterialType> m_pixels;
+    int m_stride; // dense row length, the width plus the ring's two cells
+    int m_chunksX;
+    int m_chunksY;
+    bool m_sparse;
+    AlignedVector<MaterialType> m_pixels;
+    AlignedVector<uint8_t> m_flags;
+    AlignedVector<int8_t> m_velocityX;
+    AlignedVector<int8_t> m_velocityY;
+    // Low 16 bits of the tick a timed cell expires at. Always allocated,
+    // since timed materials can be created by the parallel passes.
+    AlignedVector<uint16_t> m_timerTick;
+    // Words are shared by neighbouring chunks' border cells, hence atomic
+    std::vector<std::atomic<uint64_t>> m_emptyBits;
+    std::vector<std::atomic<uint64_t>> m_powderBits;
+    bool m_bitPlanes;
+    // Dense worlds hold every chunk in row-major order. Sparse worlds hold
+    // the allocated chunks, found through m_chunkSlots.
+    std::vector<Chunk> m_chunks;
+    std::unordered_map<uint64_t, int> m_chunkSlots;
+    // Sparse storage: the block of chunk i is m_chunkBlocks[i + 1], with
+    // the shared air block first for chunk -1, and m_blockChunks maps a
+    // block back to its chunk. Released blocks wait in m_freeBlocks.
+    std::vector<size_t> m_chunkBlocks;
+    std::vector<int> m_blockChunks;
+    std::vector<size_t> m_freeBlocks;
+    std::vector<int> m_passChunks;
+    std::unique_ptr<ThreadPool> m_threadPool;
+    ParticleSystem m_particles;
+    FieldSet m_fields;
+    ScalarField* m_heat;
+    // Events hold the CellId a timer was started or last moved at, and go
+    // stale when the cell moves or changes; ExpireTimers checks them
+    // against CELL_TIMED and m_timerTick.
+    TimingWheel m_timers;
+    std::mutex m_timersLock;
+    std::vector<TimingWheel::Event> m_dueTimers;
+    size_t m_timersDue;
     bool m_updateDirection;
-};
\ No newline at end of file
+    size_t m_cellsScanned;
+    size_t m_cellsUpdated;
+    size_t m_cellsReactionChecked;
+    size_t m_chunksDeferred;
+    uint64_t m_changeStamp;
+    // Stamp of the last chunk release; unallocated chunks report it
+    uint64_t m_releaseStamp;
+    uint64_t m_stateHash;
+    // Chunks stamped at or after this changed since the last state hash
+    uint64_t m_laneHashStamp;
+    // Oldest first; only the newest one takes new chunk copies
+    std::vector<Checkpoint> m_checkpoints;
+    uint64_t m_newestCheckpoint;
+    size_t m_checkpointBytes;
+    size_t m_checkpointBudget;
+    uint64_t m_lastCheckpointId;
+    std::vector<std::pair<int, const SavedChunk*>> m_restoreChunks;
+    std::vector<size_t> m_restoreRows; // first entry of each row of chunks
+    std::mutex m_checkpointLock;
+    // Focus rects in chunk coordinates
+    std::vector<DirtyRect> m_focusRects;
+    int m_focusMargin;
+    int m_distantInterval;
+    uint64_t m_seed;
+    uint64_t m_tick;
+    uint64_t m_tickRandomKey;
+    int m_levelingInterval;
+    // Scratch buffers reused by every levelling pass
+    std::vector<size_t> m_levelVisited;
+    std::vector<int64_t> m_levelStack;
+    std::vector<int64_t> m_levelSources;
+    std::vector<int64_t> m_levelTargets;
+    // Half widths of each row of the last FillCircle, by dy + radius
+    std::vector<int> m_circleSpans;
+    int m_circleRadius;
+};
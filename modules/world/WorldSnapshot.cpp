@@ -0,0 +1,48 @@
+#include "WorldSnapshot.h"
+#include "World.h"
+
+WorldSnapshot::WorldSnapshot(int width, int height)
+    : m_back(2)
+    , m_front(0)
+    , m_middle(1)
+    , m_chunksCopied(0) {
+    for (Frame& frame : m_frames) {
+        frame.width = width;
+        frame.height = height;
+        frame.cells.assign(static_cast<size_t>(width) * height, MaterialType::Air);
+    }
+}
+
+void WorldSnapshot::Publish(const World& world) {
+    Frame& frame = m_frames[m_back];
+    const int size = World::CHUNK_SIZE;
+
+    // A frame filled at stamp S is stale only in chunks written at S or later
+    m_chunksCopied = 0;
+    for (int cy = 0; cy < world.GetChunkCountY(); cy++) {
+        for (int cx = 0; cx < world.GetChunkCountX(); cx++) {
+            if (world.GetChunkChangeStamp(cx, cy) >= frame.stamp) {
+                size_t corner = static_cast<size_t>(cy) * size * frame.width + static_cast<size_t>(cx) * size;
+                world.CopyChunkCells(cx, cy, &frame.cells[corner], frame.width);
+                m_chunksCopied++;
+            }
+        }
+    }
+    frame.stamp = world.GetChangeStamp();
+    frame.tick = world.GetTick();
+
+    const ParticleSystem& particles = world.GetParticles();
+    frame.particles.resize(particles.GetCount());
+    for (size_t i = 0; i < particles.GetCount(); i++) {
+        frame.particles[i] = {particles.GetX(i), particles.GetY(i), particles.GetMaterial(i)};
+    }
+
+    m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+}
+
+const WorldSnapshot::Frame& WorldSnapshot::Acquire() {
+    if (m_middle.load(std::memory_order_relaxed) & FRESH) {
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+    return m_frames[m_front];
+}
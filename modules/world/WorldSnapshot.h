@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../materials/Materials.h"
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class World;
+
+// Finished frames of a World for a reader on another thread, e.g. the
+// renderer. Three frames rotate through one atomic index: the simulation
+// fills the back frame and swaps it into the middle, and the reader swaps
+// the middle out whenever it holds a newer frame. Neither side ever waits
+// for the other, and the reader never sees a frame being written.
+class WorldSnapshot {
+public:
+    struct Particle {
+        float x;
+        float y;
+        MaterialType material;
+    };
+
+    struct Frame {
+        int width = 0;
+        int height = 0;
+        uint64_t tick = 0;
+        uint64_t stamp = 0;               // world change stamp when filled
+        std::vector<MaterialType> cells;  // row-major
+        std::vector<Particle> particles;  // in flight, drawn over the cells
+
+        MaterialType GetPixel(int x, int y) const { return cells[static_cast<size_t>(y) * width + x]; }
+    };
+
+    WorldSnapshot(int width, int height);
+
+    // Simulation side. Copies the chunks that changed since the back frame
+    // was last filled, then makes it the latest frame.
+    void Publish(const World& world);
+    size_t GetChunksCopiedLastPublish() const { return m_chunksCopied; }
+
+    // Reader side. Returns the latest published frame, which stays
+    // unchanged until the next Acquire. All air before the first Publish.
+    const Frame& Acquire();
+
+private:
+    static constexpr int INDEX_MASK = 3;
+    static constexpr int FRESH = 4; // the middle frame has not been acquired
+
+    Frame m_frames[3];
+    int m_back;
+    int m_front;
+    std::atomic<int> m_middle;
+    size_t m_chunksCopied;
+};
@@ -1,18 +1,51 @@
 #include "../modules/core/Application.h"
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+
+static int Usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--seed N]" << std::endl;
+    return -1;
+}
 
 int main(int argc, char* argv[]) {
-    (void)argc;
-    (void)argv;
+    // --seed N runs in deterministic lockstep mode
+    bool lockstep = false;
+    uint64_t seed = 0;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) != "--seed") {
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "--seed needs a value" << std::endl;
+            return Usage(argv[0]);
+        }
+        std::string value = argv[++i];
+        try {
+            size_t used = 0;
+            seed = std::stoull(value, &used);
+            if (used != value.size() || value[0] == '-') {
+                throw std::invalid_argument(value);
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid seed: " << value << std::endl;
+            return Usage(argv[0]);
+        }
+        lockstep = true;
+    }
 
     Application app("Funhouse - Falling Sand Engine", 1280, 720);
-    
+    if (lockstep) {
+        app.EnableLockstep(seed);
+    }
+
     if (!app.Initialize()) {
         std::cerr << "Failed to initialize application!" << std::endl;
         return -1;
     }
 
     app.Run();
-    
+
     return 0;
-}
\ No newline at end of file
+}
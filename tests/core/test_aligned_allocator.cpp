@@ -0,0 +1,25 @@
+#include "../external/catch_amalgamated.hpp"
+#include "../../modules/core/AlignedAllocator.h"
+#include <cstdint>
+
+TEST_CASE("AlignedAllocator functionality", "[AlignedAllocator]") {
+    SECTION("Storage starts on a cache line") {
+        for (std::size_t size : {1, 3, 64, 1000, 4097}) {
+            AlignedVector<uint8_t> bytes(size);
+            AlignedVector<int16_t> shorts(size);
+            REQUIRE(reinterpret_cast<uintptr_t>(bytes.data()) % CACHE_LINE_SIZE == 0);
+            REQUIRE(reinterpret_cast<uintptr_t>(shorts.data()) % CACHE_LINE_SIZE == 0);
+        }
+    }
+
+    SECTION("Behaves like a normal vector") {
+        AlignedVector<int> values(10, 7);
+        values.push_back(8);
+        AlignedVector<int> copy = values;
+
+        REQUIRE(copy.size() == 11);
+        REQUIRE(copy[0] == 7);
+        REQUIRE(copy[10] == 8);
+        REQUIRE(reinterpret_cast<uintptr_t>(copy.data()) % CACHE_LINE_SIZE == 0);
+    }
+}
@@ -0,0 +1,47 @@
+#include "../external/catch_amalgamated.hpp"
+#include "../../modules/core/ThreadPool.h"
+#include <atomic>
+#include <vector>
+
+TEST_CASE("ThreadPool functionality", "[ThreadPool]") {
+    SECTION("Reports the configured thread count") {
+        ThreadPool single(1);
+        ThreadPool quad(4);
+        ThreadPool clamped(0);
+
+        REQUIRE(single.GetThreadCount() == 1);
+        REQUIRE(quad.GetThreadCount() == 4);
+        REQUIRE(clamped.GetThreadCount() == 1);
+    }
+
+    SECTION("ParallelFor visits every index exactly once") {
+        ThreadPool pool(4);
+        std::vector<std::atomic<int>> visits(1000);
+
+        pool.ParallelFor(1000, [&](int i) { visits[i]++; });
+
+        for (const auto& count : visits) {
+            REQUIRE(count == 1);
+        }
+    }
+
+    SECTION("Pool can be reused for many jobs") {
+        ThreadPool pool(3);
+        std::atomic<int> total{0};
+
+        for (int job = 0; job < 200; job++) {
+            pool.ParallelFor(10, [&](int) { total++; });
+        }
+
+        REQUIRE(total == 2000);
+    }
+
+    SECTION("Empty jobs return immediately") {
+        ThreadPool pool(2);
+        bool called = false;
+
+        pool.ParallelFor(0, [&](int) { called = true; });
+
+        REQUIRE_FALSE(called);
+    }
+}
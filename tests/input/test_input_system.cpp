@@ -1,6 +1,7 @@
 #include "../external/catch_amalgamated.hpp"
 #include "../../modules/input/InputSystem.h"
 #include "../../modules/world/World.h"
+#include "../../modules/input/Commands/MouseCommands.h"
 #include <SDL2/SDL.h>
 
 using namespace Funhouse;
@@ -129,3 +130,160 @@ TEST_CASE("InputSystem mouse button handling", "[InputSystem][Mouse]") {
         REQUIRE(mouseState.leftPressed == false);
     }
 }
+
+TEST_CASE("InputSystem lockstep playback", "[InputSystem][Lockstep]") {
+    SECTION("Recorded commands hold ticks relative to the recording") {
+        ::World world(64, 64);
+        InputSystem inputSystem;
+        inputSystem.SetWorld(&world);
+        inputSystem.SetLockstep(true);
+        world.Update();
+        world.Update();
+
+        inputSystem.StartRecording();
+        for (int tick = 0; tick < 6; tick++) {
+            if (tick == 0 || tick == 3) {
+                inputSystem.QueueCommand(std::make_unique<MouseDrawCommand>(&world, tick, 0, 1, MaterialType::Stone, false));
+            }
+            inputSystem.Update();
+            inputSystem.ExecuteCommands();
+            world.Update();
+        }
+        inputSystem.StopRecording();
+
+        const auto& recorded = inputSystem.GetRecordedCommands();
+        REQUIRE(recorded.size() == 2);
+        REQUIRE(recorded[0]->GetTick() == 0);
+        REQUIRE(recorded[1]->GetTick() == 3);
+    }
+
+    SECTION("Playback reproduces a seeded run for any thread count") {
+        ::World live(128, 128);
+        ::World replay(128, 128);
+        live.SetSeed(7);
+        replay.SetSeed(7);
+        replay.SetThreadCount(4);
+
+        const uint64_t ticks[] = {0, 5, 12, 30};
+        std::vector<InputCommandPtr> log;
+        for (uint64_t tick : ticks) {
+            log.push_back(std::make_unique<MouseDrawCommand>(&replay, 20 + tick, 10, 6, MaterialType::Sand, false));
+            log.back()->SetTick(tick);
+        }
+
+        InputSystem replayInput;
+        replayInput.SetWorld(&replay);
+        replayInput.SetLockstep(true);
+        replayInput.StartPlayback(log);
+
+        uint64_t firstHash = 0;
+        for (uint64_t tick = 0; tick < 80; tick++) {
+            for (uint64_t commandTick : ticks) {
+                if (commandTick == tick) {
+                    MouseDrawCommand(&live, 20 + tick, 10, 6, MaterialType::Sand, false).Execute();
+                }
+            }
+            replayInput.Update();
+            replayInput.ExecuteCommands();
+            live.Update();
+            replay.Update();
+
+            REQUIRE(live.GetStateHash() == replay.GetStateHash());
+            if (tick == 0) firstHash = live.GetStateHash();
+        }
+        REQUIRE_FALSE(replayInput.IsPlayingBack());
+        REQUIRE(live.GetStateHash() != firstHash);
+    }
+}
+
+TEST_CASE("InputSystem undo history", "[InputSystem][Undo]") {
+    // The world must outlive the commands kept for undo
+    ::World world(128, 128);
+    InputSystem inputSystem;
+    inputSystem.SetWorld(&world);
+    
+    SECTION("Undo and redo walk back and forth through world commands") {
+        inputSystem.QueueCommand(std::make_unique<PlaceMaterialCommand>(&world, 10, 10, MaterialType::Stone));
+        inputSystem.QueueCommand(std::make_unique<PlaceMaterialCommand>(&world, 100, 100, MaterialType::Stone));
+        inputSystem.ExecuteCommands();
+        REQUIRE(inputSystem.GetUndoCount() == 2);
+        
+        REQUIRE(inputSystem.Undo());
+        REQUIRE(world.GetPixel(100, 100) == MaterialType::Air);
+        REQUIRE(world.GetPixel(10, 10) == MaterialType::Stone);
+        REQUIRE(inputSystem.Undo());
+        REQUIRE(world.GetPixel(10, 10) == MaterialType::Air);
+        REQUIRE_FALSE(inputSystem.Undo());
+        
+        REQUIRE(inputSystem.Redo());
+        REQUIRE(world.GetPixel(10, 10) == MaterialType::Stone);
+        REQUIRE(inputSystem.GetRedoCount() == 1);
+        
+        // A new command drops what could have been redone
+        inputSystem.QueueCommand(std::make_unique<RemoveMaterialCommand>(&world, 10, 10));
+        inputSystem.ExecuteCommands();
+        REQUIRE(inputSystem.GetRedoCount() == 0);
+        REQUIRE_FALSE(inputSystem.Redo());
+    }
+    
+    SECTION("History is bounded and releases old checkpoints") {
+        for (size_t i = 0; i < InputSystem::MAX_UNDO_HISTORY + 10; i++) {
+            inputSystem.QueueCommand(std::make_unique<PlaceMaterialCommand>(&world, static_cast<int>(i), 0, MaterialType::Stone));
+        }
+        inputSystem.ExecuteCommands();
+        REQUIRE(inputSystem.GetUndoCount() == InputSystem::MAX_UNDO_HISTORY);
+        REQUIRE(world.GetCheckpointCount() == InputSystem::MAX_UNDO_HISTORY);
+    }
+    
+    SECTION("Entries whose checkpoint the world dropped are discarded") {
+        world.SetCheckpointBudget(0);
+        inputSystem.QueueCommand(std::make_unique<PlaceMaterialCommand>(&world, 10, 10, MaterialType::Stone));
+        inputSystem.QueueCommand(std::make_unique<PlaceMaterialCommand>(&world, 100, 100, MaterialType::Stone));
+        inputSystem.ExecuteCommands();
+        REQUIRE(world.GetCheckpointCount() == 1);
+        REQUIRE(inputSystem.GetUndoCount() == 1);
+        
+        REQUIRE(inputSystem.Undo());
+        REQUIRE(world.GetPixel(100, 100) == MaterialType::Air);
+        REQUIRE_FALSE(inputSystem.Undo());
+        REQUIRE(world.GetPixel(10, 10) == MaterialType::Stone);
+    }
+    
+    SECTION("A brush stroke is one undo entry with one checkpoint") {
+        for (int x = 10; x < 40; x++) {
+            inputSystem.QueueCommand(std::make_unique<MouseDrawCommand>(&world, x, 20, 3, MaterialType::Stone, false, 1));
+            inputSystem.ExecuteCommands();
+            world.Update();
+        }
+        inputSystem.QueueCommand(std::make_unique<MouseDrawCommand>(&world, 80, 80, 3, MaterialType::Stone, false, 2));
+        inputSystem.ExecuteCommands();
+        REQUIRE(inputSystem.GetUndoCount() == 2);
+        REQUIRE(world.GetCheckpointCount() == 2);
+        
+        REQUIRE(inputSystem.Undo());
+        REQUIRE(world.GetPixel(80, 80) == MaterialType::Air);
+        REQUIRE(world.GetPixel(39, 20) == MaterialType::Stone);
+        REQUIRE(inputSystem.Undo());
+        for (int x = 10; x < 40; x++) {
+            REQUIRE(world.GetPixel(x, 20) == MaterialType::Air);
+        }
+        
+        REQUIRE(inputSystem.Redo());
+        for (int x = 10; x < 40; x++) {
+            REQUIRE(world.GetPixel(x, 20) == MaterialType::Stone);
+        }
+        REQUIRE(world.GetCheckpointCount() == 1);
+    }
+    
+    SECTION("Undo is off in lockstep, where it could not be replayed") {
+        inputSystem.SetLockstep(true);
+        inputSystem.QueueCommand(std::make_unique<PlaceMaterialCommand>(&world, 10, 10, MaterialType::Stone));
+        inputSystem.ExecuteCommands();
+        REQUIRE(world.GetPixel(10, 10) == MaterialType::Stone);
+        REQUIRE(inputSystem.GetUndoCount() == 0);
+        REQUIRE(world.GetCheckpointCount() == 0);
+        REQUIRE_FALSE(inputSystem.Undo());
+        REQUIRE(world.GetPixel(10, 10) == MaterialType::Stone);
+    }
+}
+
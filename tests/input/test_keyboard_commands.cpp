@@ -175,4 +175,20 @@ TEST_CASE("ClearWorldCommand functionality", "[KeyboardCommands][ClearWorld]") {
         auto command = std::make_unique<ClearWorldCommand>(&world);
         REQUIRE(command->IsReplayable());
     }
+    
+    SECTION("ClearWorldCommand can be undone") {
+        auto command = std::make_unique<ClearWorldCommand>(&world);
+        REQUIRE(command->IsUndoable());
+        
+        command->Execute();
+        REQUIRE(world.GetPixel(5, 5) == MaterialType::Air);
+        
+        command->Undo();
+        REQUIRE(world.GetPixel(5, 5) == MaterialType::Sand);
+        REQUIRE(world.GetPixel(3, 7) == MaterialType::Water);
+        
+        // Redo runs the command again
+        command->Execute();
+        REQUIRE(world.GetPixel(5, 5) == MaterialType::Air);
+    }
 }
@@ -126,3 +126,57 @@ TEST_CASE("Mouse commands inheritance", "[MouseCommands][Inheritance]") {
         REQUIRE(timestamp <= after);
     }
 }
+
+TEST_CASE("Mouse commands undo", "[MouseCommands][Undo]") {
+    ::World world(100, 100);
+    world.SetPixel(50, 50, MaterialType::Stone);
+    
+    SECTION("MouseDrawCommand undo restores the cells under the brush") {
+        MouseDrawCommand command(&world, 50, 50, 9, MaterialType::Sand, false);
+        REQUIRE(command.IsUndoable());
+        
+        command.Execute();
+        REQUIRE(world.GetPixel(50, 50) == MaterialType::Sand);
+        REQUIRE(world.GetPixel(52, 51) == MaterialType::Sand);
+        
+        command.Undo();
+        REQUIRE(world.GetPixel(50, 50) == MaterialType::Stone);
+        REQUIRE(world.GetPixel(52, 51) == MaterialType::Air);
+        REQUIRE(world.GetCheckpointCount() == 0);
+    }
+    
+    SECTION("Erasing can be undone") {
+        MouseDrawCommand command(&world, 50, 50, 5, MaterialType::Sand, true);
+        command.Execute();
+        REQUIRE(world.GetPixel(50, 50) == MaterialType::Air);
+        command.Undo();
+        REQUIRE(world.GetPixel(50, 50) == MaterialType::Stone);
+    }
+    
+    SECTION("Destroying a command releases its checkpoint") {
+        {
+            PlaceMaterialCommand command(&world, 10, 10, MaterialType::Water);
+            command.Execute();
+            REQUIRE(world.GetCheckpointCount() == 1);
+        }
+        REQUIRE(world.GetCheckpointCount() == 0);
+        REQUIRE(world.GetPixel(10, 10) == MaterialType::Water);
+    }
+    
+    SECTION("A command whose checkpoint was dropped can no longer undo") {
+        world.SetCheckpointBudget(0);
+        PlaceMaterialCommand first(&world, 10, 10, MaterialType::Water);
+        PlaceMaterialCommand second(&world, 90, 90, MaterialType::Water);
+        first.Execute();
+        REQUIRE(first.CanUndo());
+        second.Execute();
+        REQUIRE_FALSE(first.CanUndo());
+        REQUIRE(second.CanUndo());
+        
+        first.Undo();
+        REQUIRE(world.GetPixel(10, 10) == MaterialType::Water);
+        second.Undo();
+        REQUIRE(world.GetPixel(90, 90) == MaterialType::Air);
+    }
+}
+
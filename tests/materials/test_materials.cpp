@@ -0,0 +1,100 @@
+#include "../external/catch_amalgamated.hpp"
+#include "../../modules/materials/Materials.h"
+
+TEST_CASE("Material displacement table", "[Materials]") {
+    SECTION("Table is available at compile time") {
+        STATIC_REQUIRE(CanDisplace(MaterialType::Sand, MaterialType::Air));
+        STATIC_REQUIRE(CanDisplace(MaterialType::Water, MaterialType::Air));
+    }
+
+    SECTION("Heavier materials sink through lighter liquids") {
+        REQUIRE(CanDisplace(MaterialType::Sand, MaterialType::Water));
+        REQUIRE_FALSE(CanDisplace(MaterialType::Water, MaterialType::Sand));
+    }
+
+    SECTION("Solids are never displaced") {
+        for (int m = 0; m < MATERIAL_COUNT; m++) {
+            MaterialType mover = static_cast<MaterialType>(m);
+            REQUIRE_FALSE(CanDisplace(mover, MaterialType::Stone));
+            REQUIRE_FALSE(CanDisplace(mover, MaterialType::Sand));
+        }
+    }
+
+    SECTION("Nothing displaces its own material") {
+        for (int m = 0; m < MATERIAL_COUNT; m++) {
+            MaterialType material = static_cast<MaterialType>(m);
+            REQUIRE_FALSE(CanDisplace(material, material));
+        }
+    }
+}
+
+TEST_CASE("Material gases and phase changes", "[Materials]") {
+    SECTION("Gases rise through anything non-solid and denser") {
+        STATIC_REQUIRE(CanRise(MaterialType::Steam, MaterialType::Air));
+        REQUIRE(CanRise(MaterialType::Steam, MaterialType::Water));
+        REQUIRE_FALSE(CanRise(MaterialType::Steam, MaterialType::Stone));
+        REQUIRE_FALSE(CanRise(MaterialType::Steam, MaterialType::Sand));
+        REQUIRE_FALSE(CanRise(MaterialType::Steam, MaterialType::Steam));
+    }
+
+    SECTION("Falling materials sink through gases") {
+        REQUIRE(CanDisplace(MaterialType::Sand, MaterialType::Steam));
+        REQUIRE(CanDisplace(MaterialType::Water, MaterialType::Steam));
+    }
+
+    SECTION("Water and steam change into each other") {
+        STATIC_REQUIRE(HasHotterPhase(MaterialType::Water));
+        STATIC_REQUIRE(HasColderPhase(MaterialType::Steam));
+        STATIC_REQUIRE_FALSE(HasHotterPhase(MaterialType::Stone));
+        STATIC_REQUIRE(LowestHotterPhaseTemperature() == 100.0f);
+        REQUIRE(PHASE_CHANGES[static_cast<int>(MaterialType::Water)].hotter == MaterialType::Steam);
+        REQUIRE(PHASE_CHANGES[static_cast<int>(MaterialType::Steam)].colder == MaterialType::Water);
+    }
+}
+
+TEST_CASE("Material reaction table", "[Materials]") {
+    constexpr int lava = static_cast<int>(MaterialType::Lava);
+    constexpr int water = static_cast<int>(MaterialType::Water);
+
+    SECTION("Rules apply from both sides of the pair") {
+        const ReactionEntry& fromLava = REACTION_TABLE.entries[lava][water];
+        const ReactionEntry& fromWater = REACTION_TABLE.entries[water][lava];
+        REQUIRE(fromLava.becomes == MaterialType::Stone);
+        REQUIRE(fromLava.otherBecomes == MaterialType::Steam);
+        REQUIRE(fromWater.becomes == MaterialType::Steam);
+        REQUIRE(fromWater.otherBecomes == MaterialType::Stone);
+        REQUIRE(fromLava.threshold == fromWater.threshold);
+        REQUIRE(fromLava.threshold > 0);
+    }
+
+    SECTION("Partner masks list only materials with a rule") {
+        constexpr int fire = static_cast<int>(MaterialType::Fire);
+        STATIC_REQUIRE(REACTION_TABLE.partners[lava] == 1u << water);
+        STATIC_REQUIRE(REACTION_TABLE.partners[water] == ((1u << lava) | (1u << fire)));
+        STATIC_REQUIRE(REACTION_TABLE.partners[static_cast<int>(MaterialType::Sand)] == 0);
+        REQUIRE(REACTION_TABLE.entries[static_cast<int>(MaterialType::Sand)][water].threshold == 0);
+    }
+
+    SECTION("Probabilities scale to 32-bit thresholds") {
+        STATIC_REQUIRE(ReactionThreshold(0.0f) == 0);
+        STATIC_REQUIRE(ReactionThreshold(0.5f) == 0x80000000u);
+        STATIC_REQUIRE(ReactionThreshold(1.0f) == 0xFFFFFFFFu);
+    }
+}
+
+TEST_CASE("Material timed transitions", "[Materials]") {
+    SECTION("Fire burns out into air on its own") {
+        const TimedTransition& fire = TIMED_TRANSITIONS[static_cast<int>(MaterialType::Fire)];
+        REQUIRE(fire.expired == MaterialType::Air);
+        REQUIRE(fire.lifetime > 0);
+        REQUIRE(fire.lifetimeJitter >= 0);
+    }
+
+    SECTION("Other materials only expire when given a timer") {
+        for (int m = 0; m < MATERIAL_COUNT; m++) {
+            if (static_cast<MaterialType>(m) != MaterialType::Fire) {
+                REQUIRE(TIMED_TRANSITIONS[m].lifetime == 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,164 @@
+#include "../external/catch_amalgamated.hpp"
+#include "../../modules/simulation/ScalarField.h"
+#include "../../modules/core/ThreadPool.h"
+
+namespace {
+
+float Total(const ScalarField& field) {
+    float total = 0.0f;
+    for (int y = 0; y < field.GetHeight(); y++) {
+        for (int x = 0; x < field.GetWidth(); x++) {
+            total += field.Get(x, y);
+        }
+    }
+    return total;
+}
+
+} // namespace
+
+TEST_CASE("ScalarField stepping", "[ScalarField]") {
+    FieldParameters params;
+    params.diffusion = 0.2f;
+
+    SECTION("Out of range reads return ambient") {
+        params.ambient = 20.0f;
+        ScalarField field(8, 8, params);
+        REQUIRE(field.Get(3, 3) == 20.0f);
+        REQUIRE(field.Get(-1, 3) == 20.0f);
+        field.Set(8, 0, 5.0f);
+        REQUIRE(field.Get(8, 0) == 20.0f);
+    }
+
+    SECTION("Diffusion spreads a peak and conserves the total") {
+        ScalarField field(37, 29, params);
+        field.Set(18, 14, 1000.0f);
+
+        for (int i = 0; i < 50; i++) {
+            field.Step(nullptr);
+        }
+
+        REQUIRE(field.Get(18, 14) < 1000.0f);
+        REQUIRE(field.Get(20, 14) > 0.0f);
+        REQUIRE(field.Get(18, 14) > field.Get(22, 14));
+        REQUIRE(Total(field) == Catch::Approx(1000.0f).epsilon(1e-4));
+    }
+
+    SECTION("Advection moves values with the velocity") {
+        params.diffusion = 0.0f;
+        params.velocityY = -1.0f;
+        ScalarField field(16, 16, params);
+        field.Set(5, 10, 7.0f);
+
+        field.Step(nullptr);
+        field.Step(nullptr);
+
+        REQUIRE(field.Get(5, 8) == Catch::Approx(7.0f));
+        REQUIRE(field.Get(5, 10) == 0.0f);
+    }
+
+    SECTION("Decay relaxes toward ambient") {
+        params.decay = 0.1f;
+        params.ambient = 20.0f;
+        ScalarField field(8, 8, params);
+        field.Fill(100.0f);
+
+        for (int i = 0; i < 200; i++) {
+            field.Step(nullptr);
+        }
+        REQUIRE(field.Get(4, 4) == Catch::Approx(20.0f).epsilon(1e-3));
+    }
+
+    SECTION("A field at rest stays exactly at ambient and hashes to zero") {
+        params.velocityY = -0.1f;
+        params.decay = 0.01f;
+        params.ambient = 20.0f;
+        ScalarField field(16, 16, params);
+
+        for (int i = 0; i < 100; i++) {
+            field.Step(nullptr);
+        }
+        for (int y = 0; y < 16; y++) {
+            for (int x = 0; x < 16; x++) {
+                REQUIRE(field.Get(x, y) == 20.0f);
+            }
+        }
+        REQUIRE(field.GetHash() == 0);
+
+        field.Add(3, 4, 1.0f);
+        REQUIRE(field.GetHash() != 0);
+    }
+
+    SECTION("Threaded steps match serial steps") {
+        ScalarField serial(100, 90, params);
+        ScalarField parallel(100, 90, params);
+        ThreadPool pool(4);
+        for (int i = 0; i < 30; i++) {
+            serial.Add(i * 3, i * 2, 50.0f);
+            parallel.Add(i * 3, i * 2, 50.0f);
+        }
+
+        for (int i = 0; i < 20; i++) {
+            serial.Step(nullptr);
+            parallel.Step(&pool);
+        }
+
+        for (int y = 0; y < 90; y++) {
+            for (int x = 0; x < 100; x++) {
+                REQUIRE(serial.Get(x, y) == parallel.Get(x, y));
+            }
+        }
+        REQUIRE(serial.GetHash() == parallel.GetHash());
+    }
+
+    SECTION("The kept hash matches a field rebuilt from its samples") {
+        params.velocityX = 0.05f;
+        params.decay = 0.02f;
+        params.ambient = 20.0f;
+        ScalarField field(101, 90, params);
+        ThreadPool pool(4);
+
+        auto rebuiltHash = [&]() {
+            ScalarField rebuilt(101, 90, field.GetParameters());
+            for (int y = 0; y < 90; y++) {
+                for (int x = 0; x < 101; x++) {
+                    rebuilt.Set(x, y, field.Get(x, y));
+                }
+            }
+            return rebuilt.GetHash();
+        };
+
+        for (int i = 0; i < 40; i++) {
+            field.Add((i * 37) % 101, (i * 11) % 90, 60.0f);
+            field.Set((i * 53) % 101, (i * 29) % 90, 20.0f);
+            field.Step(i % 2 ? &pool : nullptr);
+            REQUIRE(field.GetHash() == rebuiltHash());
+        }
+
+        params.ambient = 25.0f;
+        field.SetParameters(params);
+        REQUIRE(field.GetHash() == rebuiltHash());
+
+        field.Fill(25.0f);
+        REQUIRE(field.GetHash() == 0);
+    }
+}
+
+TEST_CASE("FieldSet named fields", "[ScalarField]") {
+    FieldSet fields(1024, 1000, 4);
+    REQUIRE(fields.GetSampleWidth() == 256);
+    REQUIRE(fields.GetSampleHeight() == 250);
+
+    FieldParameters pressure;
+    pressure.ambient = 1.0f;
+    ScalarField& added = fields.Add("pressure", pressure);
+    fields.Add("gas", FieldParameters());
+
+    REQUIRE(fields.GetCount() == 2);
+    REQUIRE(fields.Find("pressure") == &added);
+    REQUIRE(&fields.Add("pressure", FieldParameters()) == &added);
+    REQUIRE(fields.Find("missing") == nullptr);
+
+    added.Set(3, 3, 9.0f);
+    fields.Reset();
+    REQUIRE(added.Get(3, 3) == 1.0f);
+}
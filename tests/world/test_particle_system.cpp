@@ -0,0 +1,176 @@
+#include "../external/catch_amalgamated.hpp"
+#include "../../modules/world/ParticleSystem.h"
+#include "../../modules/world/World.h"
+
+namespace {
+
+int CountMaterial(const World& world, MaterialType material) {
+    int count = 0;
+    for (int y = 0; y < world.GetHeight(); y++) {
+        for (int x = 0; x < world.GetWidth(); x++) {
+            if (world.GetPixel(x, y) == material) count++;
+        }
+    }
+    return count;
+}
+
+} // namespace
+
+TEST_CASE("ParticleSystem pool", "[ParticleSystem]") {
+    SECTION("Spawn fails once the pool is full") {
+        ParticleSystem particles(3);
+        REQUIRE(particles.Spawn(1, 1, 0, 0, MaterialType::Sand));
+        REQUIRE(particles.Spawn(2, 1, 0, 0, MaterialType::Sand));
+        REQUIRE(particles.Spawn(3, 1, 0, 0, MaterialType::Sand));
+        REQUIRE_FALSE(particles.Spawn(4, 1, 0, 0, MaterialType::Sand));
+        REQUIRE(particles.GetCount() == 3);
+
+        particles.Clear();
+        REQUIRE(particles.GetCount() == 0);
+        REQUIRE(particles.GetCapacity() == 3);
+    }
+
+    SECTION("Collisions follow material properties") {
+        REQUIRE_FALSE(ParticleSystem::Blocks(MaterialType::Air));
+        REQUIRE(ParticleSystem::Blocks(MaterialType::Sand));
+        REQUIRE(ParticleSystem::Blocks(MaterialType::Water));
+        REQUIRE(ParticleSystem::Blocks(MaterialType::Stone));
+    }
+}
+
+TEST_CASE("ParticleSystem in a World", "[ParticleSystem][World]") {
+    World world(64, 64);
+    for (int x = 0; x < 64; x++) {
+        world.SetPixel(x, 63, MaterialType::Stone);
+    }
+
+    SECTION("An ejected pixel flies and lands back on the grid") {
+        world.SetPixel(10, 40, MaterialType::Sand);
+        REQUIRE(world.EjectPixel(10, 40, 1.0f, -3.0f));
+        REQUIRE(world.GetPixel(10, 40) == MaterialType::Air);
+        REQUIRE(world.GetParticles().GetCount() == 1);
+
+        world.Update();
+        REQUIRE(world.GetParticles().GetX(0) > 10.5f);
+        REQUIRE(world.GetParticles().GetY(0) < 40.5f);
+
+        for (int i = 0; i < 60 && world.GetParticles().GetCount() > 0; i++) {
+            world.Update();
+        }
+
+        REQUIRE(world.GetParticles().GetCount() == 0);
+        REQUIRE(CountMaterial(world, MaterialType::Sand) == 1);
+        int landedX = -1;
+        for (int x = 0; x < 64; x++) {
+            if (world.GetPixel(x, 62) == MaterialType::Sand) landedX = x;
+        }
+        REQUIRE(landedX > 10);
+    }
+
+    SECTION("A fast particle stops at the first wall on its path") {
+        for (int y = 0; y < 63; y++) {
+            world.SetPixel(30, y, MaterialType::Stone);
+        }
+        world.GetParticles().Spawn(5.5f, 20.5f, 30.0f, 0.0f, MaterialType::Water);
+
+        world.Update();
+
+        REQUIRE(world.GetParticles().GetCount() == 0);
+        REQUIRE(world.GetPixel(29, 20) == MaterialType::Water);
+    }
+
+    SECTION("A particle whose column is full lands in the nearest free cell") {
+        for (int y = 0; y < 63; y++) {
+            world.SetPixel(10, y, MaterialType::Stone);
+        }
+        world.GetParticles().Spawn(10.5f, 30.5f, 0.0f, 0.0f, MaterialType::Sand);
+
+        world.Update();
+
+        REQUIRE(world.GetParticles().GetCount() == 0);
+        REQUIRE(CountMaterial(world, MaterialType::Sand) == 1);
+        REQUIRE(world.GetPixel(9, 29) == MaterialType::Sand);
+    }
+
+    SECTION("A particle outside the world lands at its border") {
+        world.GetParticles().Spawn(-5.5f, 20.5f, 0.0f, 0.0f, MaterialType::Water);
+
+        world.Update();
+
+        REQUIRE(world.GetParticles().GetCount() == 0);
+        REQUIRE(world.GetPixel(0, 20) == MaterialType::Water);
+    }
+
+    SECTION("Air cannot be ejected") {
+        REQUIRE_FALSE(world.EjectPixel(5, 5, 0, 0));
+        REQUIRE(world.GetParticles().GetCount() == 0);
+    }
+
+    SECTION("A burst of particles conserves material") {
+        for (int y = 40; y < 63; y++) {
+            for (int x = 0; x < 64; x++) {
+                world.SetPixel(x, y, (x + y) % 2 ? MaterialType::Sand : MaterialType::Water);
+            }
+        }
+        int sand = CountMaterial(world, MaterialType::Sand);
+        int water = CountMaterial(world, MaterialType::Water);
+
+        for (int y = 40; y < 50; y++) {
+            for (int x = 20; x < 44; x++) {
+                world.EjectPixel(x, y, (x - 32) * 0.5f, -4.0f);
+            }
+        }
+        for (int i = 0; i < 200; i++) {
+            world.Update();
+        }
+
+        REQUIRE(world.GetParticles().GetCount() == 0);
+        REQUIRE(CountMaterial(world, MaterialType::Sand) == sand);
+        REQUIRE(CountMaterial(world, MaterialType::Water) == water);
+    }
+}
+
+TEST_CASE("ParticleSystem landing in a solid world", "[ParticleSystem][World]") {
+    World world(512, 512);
+    world.FillRect(0, 0, 511, 511, MaterialType::Stone);
+
+    SECTION("A particle with no air near is dropped") {
+        world.SetPixel(500, 500, MaterialType::Air);
+        world.GetParticles().Spawn(10.5f, 10.5f, 0.0f, 0.0f, MaterialType::Sand);
+
+        world.Update();
+
+        REQUIRE(world.GetParticles().GetCount() == 0);
+        REQUIRE(world.GetPixel(500, 500) == MaterialType::Air);
+        REQUIRE(CountMaterial(world, MaterialType::Sand) == 0);
+    }
+
+    SECTION("Air within the landing radius still catches it") {
+        int x = 10 + ParticleSystem::MAX_LANDING_RADIUS;
+        world.SetPixel(x, 10, MaterialType::Air);
+        world.GetParticles().Spawn(10.5f, 10.5f, 0.0f, 0.0f, MaterialType::Sand);
+
+        world.Update();
+
+        REQUIRE(world.GetParticles().GetCount() == 0);
+        REQUIRE(world.GetPixel(x, 10) == MaterialType::Sand);
+    }
+}
+
+TEST_CASE("ParticleSystem handles a large pool", "[ParticleSystem]") {
+    World world(1024, 1024);
+    ParticleSystem& particles = world.GetParticles();
+    for (int i = 0; i < 100000; i++) {
+        REQUIRE(particles.Spawn(static_cast<float>(i % 1000) + 10.5f, static_cast<float>(i / 1000) + 10.5f,
+                                0.25f, -2.0f, MaterialType::Sand));
+    }
+
+    world.Update();
+    REQUIRE(particles.GetCount() == 100000);
+
+    for (int i = 0; i < 200 && particles.GetCount() > 0; i++) {
+        world.Update();
+    }
+    REQUIRE(particles.GetCount() == 0);
+    REQUIRE(CountMaterial(world, MaterialType::Sand) == 100000);
+}
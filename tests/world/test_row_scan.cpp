@@ -0,0 +1,63 @@
+#include "../external/catch_amalgamated.hpp"
+#include "../../modules/world/RowScan.h"
+#include <vector>
+
+TEST_CASE("RowScan movable masks", "[RowScan]") {
+    SECTION("Static materials are listed at compile time") {
+        STATIC_REQUIRE(STATIC_MATERIALS.count == 2);
+        REQUIRE(STATIC_MATERIALS.ids[0] == static_cast<uint8_t>(MaterialType::Air));
+        REQUIRE(STATIC_MATERIALS.ids[1] == static_cast<uint8_t>(MaterialType::Stone));
+    }
+
+    SECTION("Empty and inert rows produce an empty mask") {
+        std::vector<MaterialType> row(64, MaterialType::Air);
+        REQUIRE(MovableMask(row.data(), 64) == 0);
+
+        row.assign(64, MaterialType::Stone);
+        REQUIRE(MovableMask(row.data(), 64) == 0);
+    }
+
+    SECTION("Full row of sand sets every bit") {
+        std::vector<MaterialType> row(64, MaterialType::Sand);
+        REQUIRE(MovableMask(row.data(), 64) == ~0ull);
+        REQUIRE(MovableMask(row.data(), 5) == 0x1Full);
+    }
+
+    SECTION("Vector and scalar paths agree for every width") {
+        std::vector<MaterialType> row(80);
+        for (int i = 0; i < 80; i++) {
+            row[i] = static_cast<MaterialType>((i * 7 + i / 3) % MATERIAL_COUNT);
+        }
+
+        for (int width = 0; width <= 64; width++) {
+            for (int offset = 0; offset < 16; offset++) {
+                REQUIRE(MovableMask(row.data() + offset, width) ==
+                        MovableMaskScalar(row.data() + offset, 0, width));
+            }
+        }
+    }
+
+    SECTION("Material set masks match the listed materials") {
+        std::vector<MaterialType> row(80);
+        for (int i = 0; i < 80; i++) {
+            row[i] = static_cast<MaterialType>((i * 5 + i / 4) % MATERIAL_COUNT);
+        }
+        uint32_t sets[] = {0u, 1u << static_cast<int>(MaterialType::Water),
+                           (1u << static_cast<int>(MaterialType::Lava)) | (1u << static_cast<int>(MaterialType::Sand)),
+                           (1u << MATERIAL_COUNT) - 1};
+
+        for (uint32_t set : sets) {
+            for (int width = 0; width <= 64; width++) {
+                REQUIRE(MaterialSetMask(row.data() + 3, width, set) ==
+                        MaterialSetMaskScalar(row.data() + 3, 0, width, set));
+            }
+        }
+        REQUIRE(MaterialSetMask(row.data(), 64, (1u << MATERIAL_COUNT) - 1) == ~0ull);
+    }
+
+    SECTION("Bit helpers find both ends of a mask") {
+        REQUIRE(LowestBit(0x8010ull) == 4);
+        REQUIRE(HighestBit(0x8010ull) == 15);
+        REQUIRE(HighestBit(1ull << 63) == 63);
+    }
+}
@@ -0,0 +1,70 @@
+#include "../external/catch_amalgamated.hpp"
+#include "../../modules/world/TimingWheel.h"
+#include <vector>
+
+TEST_CASE("TimingWheel scheduling", "[TimingWheel]") {
+    TimingWheel wheel;
+    std::vector<TimingWheel::Event> due;
+
+    SECTION("Events come due exactly at their tick") {
+        wheel.Schedule(3, 1);
+        wheel.Schedule(70, 2);
+        wheel.Schedule(5000, 3);
+        wheel.Schedule(300000, 4);
+        wheel.Schedule(20000000, 5);
+        REQUIRE(wheel.GetPendingCount() == 5);
+
+        const uint64_t ticks[] = {3, 70, 5000, 300000, 20000000};
+        for (int id = 1; id <= 5; id++) {
+            wheel.Advance(ticks[id - 1] - 1, due);
+            REQUIRE(due.empty());
+            wheel.Advance(ticks[id - 1], due);
+            REQUIRE(due.size() == 1);
+            REQUIRE(due[0].id == id);
+            REQUIRE(due[0].tick == ticks[id - 1]);
+            due.clear();
+        }
+        REQUIRE(wheel.GetPendingCount() == 0);
+    }
+
+    SECTION("Every tick across level boundaries fires once") {
+        wheel.Advance(4090, due);
+        for (int i = 1; i <= 10000; i++) {
+            wheel.Schedule(4090 + i, i);
+        }
+
+        for (uint64_t tick = 4091; tick <= 4090 + 10000; tick++) {
+            wheel.Advance(tick, due);
+            REQUIRE(due.size() == 1);
+            REQUIRE(due[0].tick == tick);
+            due.clear();
+        }
+    }
+
+    SECTION("Past ticks are due on the next tick") {
+        wheel.Advance(10, due);
+        wheel.Schedule(4, 1);
+        wheel.Advance(11, due);
+        REQUIRE(due.size() == 1);
+        REQUIRE(due[0].tick == 11);
+    }
+
+    SECTION("Events sharing a far tick come due together") {
+        for (int i = 0; i < 1000; i++) {
+            wheel.Schedule(100000, i);
+        }
+        wheel.Advance(99999, due);
+        REQUIRE(due.empty());
+        wheel.Advance(100000, due);
+        REQUIRE(due.size() == 1000);
+    }
+
+    SECTION("Reset drops pending events") {
+        wheel.Schedule(8, 1);
+        wheel.Reset(20);
+        REQUIRE(wheel.GetPendingCount() == 0);
+        REQUIRE(wheel.GetCurrentTick() == 20);
+        wheel.Advance(100, due);
+        REQUIRE(due.empty());
+    }
+}
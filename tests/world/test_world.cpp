@@ -0,0 +1,1764 @@
+#include "../external/catch_amalgamated.hpp"
+#include "../../modules/world/World.h"
+#include "../../modules/materials/Materials.h"
+#include <cstdlib>
+#include <algorithm>
+
+TEST_CASE("World pixel access", "[World]") {
+    World world(100, 80);
+
+    SECTION("New world is empty") {
+        REQUIRE(world.GetWidth() == 100);
+        REQUIRE(world.GetHeight() == 80);
+        REQUIRE(world.GetPixel(0, 0) == MaterialType::Air);
+        REQUIRE(world.GetPixel(99, 79) == MaterialType::Air);
+    }
+
+    SECTION("SetPixel and GetPixel round trip") {
+        world.SetPixel(10, 20, MaterialType::Sand);
+        world.SetPixel(99, 79, MaterialType::Water);
+
+        REQUIRE(world.GetPixel(10, 20) == MaterialType::Sand);
+        REQUIRE(world.GetPixel(99, 79) == MaterialType::Water);
+    }
+
+    SECTION("Out of bounds reads return Stone and writes are ignored") {
+        world.SetPixel(-1, 5, MaterialType::Sand);
+        world.SetPixel(100, 5, MaterialType::Sand);
+
+        REQUIRE(world.GetPixel(-1, 5) == MaterialType::Stone);
+        REQUIRE(world.GetPixel(100, 5) == MaterialType::Stone);
+        REQUIRE(world.GetPixel(5, 80) == MaterialType::Stone);
+    }
+}
+
+TEST_CASE("World simulation rules", "[World]") {
+    World world(16, 16);
+    for (int x = 0; x < 16; x++) {
+        world.SetPixel(x, 15, MaterialType::Stone);
+    }
+
+    SECTION("Sand falls until it rests on Stone") {
+        world.SetPixel(4, 0, MaterialType::Sand);
+
+        for (int i = 0; i < 20; i++) {
+            world.Update();
+        }
+
+        REQUIRE(world.GetPixel(4, 0) == MaterialType::Air);
+        REQUIRE(world.GetPixel(4, 14) == MaterialType::Sand);
+    }
+
+    SECTION("Sand sinks below Water") {
+        world.SetPixel(8, 14, MaterialType::Water);
+        world.SetPixel(8, 13, MaterialType::Sand);
+        world.SetPixel(7, 14, MaterialType::Stone);
+        world.SetPixel(9, 14, MaterialType::Stone);
+
+        world.Update();
+
+        REQUIRE(world.GetPixel(8, 14) == MaterialType::Sand);
+        REQUIRE(world.GetPixel(8, 13) == MaterialType::Water);
+    }
+}
+
+TEST_CASE("World kernel table runs each material's rules", "[World][Kernels]") {
+    // One tick of a scene holding every material, in both storage modes so
+    // both KERNELS tables are used. Lava and Fire sit in chunks of their own,
+    // away from the Water they react with.
+    WorldStorage storage = GENERATE(WorldStorage::Dense, WorldStorage::Sparse);
+    World world(192, 64, storage);
+    world.SetLevelingInterval(0);
+    for (int x = 0; x < 192; x++) {
+        world.SetPixel(x, 63, MaterialType::Stone);
+    }
+
+    world.SetPixel(5, 10, MaterialType::Sand);       // falls straight down
+    world.SetPixel(15, 21, MaterialType::Stone);
+    world.SetPixel(15, 20, MaterialType::Sand);      // slides off the Stone
+    world.SetPixel(24, 62, MaterialType::Stone);
+    world.SetPixel(26, 62, MaterialType::Stone);
+    world.SetPixel(25, 62, MaterialType::Water);
+    world.SetPixel(25, 61, MaterialType::Sand);      // sinks into the Water
+    world.SetPixel(35, 62, MaterialType::Water);     // flows sideways
+    world.SetPixel(45, 30, MaterialType::Steam);     // rises
+    world.SetPixel(55, 30, MaterialType::Stone);     // stays put in mid-air
+    world.SetPixel(80, 62, MaterialType::Lava);      // flows sideways
+    world.SetPixel(150, 30, MaterialType::Fire);     // rises
+
+    world.Update();
+
+    REQUIRE(world.GetPixel(5, 10) == MaterialType::Air);
+    REQUIRE(world.GetPixel(5, 11) == MaterialType::Sand);
+    REQUIRE(world.GetVelocityY(5, 11) == 1);
+
+    REQUIRE(world.GetPixel(15, 20) == MaterialType::Air);
+    REQUIRE((world.GetPixel(14, 21) == MaterialType::Sand) != (world.GetPixel(16, 21) == MaterialType::Sand));
+
+    REQUIRE(world.GetPixel(25, 62) == MaterialType::Sand);
+    REQUIRE(world.GetPixel(25, 61) == MaterialType::Water);
+
+    REQUIRE(world.GetPixel(35, 62) == MaterialType::Air);
+    REQUIRE((world.GetPixel(34, 62) == MaterialType::Water) != (world.GetPixel(36, 62) == MaterialType::Water));
+
+    // Steam condenses at ambient heat, but only after its kernel moved it
+    REQUIRE(world.GetPixel(45, 30) == MaterialType::Air);
+    REQUIRE(world.GetPixel(45, 29) != MaterialType::Air);
+
+    REQUIRE(world.GetPixel(55, 30) == MaterialType::Stone);
+
+    REQUIRE(world.GetPixel(80, 62) == MaterialType::Air);
+    REQUIRE((world.GetPixel(79, 62) == MaterialType::Lava) != (world.GetPixel(81, 62) == MaterialType::Lava));
+
+    REQUIRE(world.GetPixel(150, 30) == MaterialType::Air);
+    REQUIRE(world.GetPixel(150, 29) == MaterialType::Fire);
+}
+
+TEST_CASE("World chunk sleep and wake", "[World][Chunks]") {
+    World world(200, 130);
+
+    SECTION("Chunk grid covers the world") {
+        REQUIRE(world.GetChunkCountX() == 4);
+        REQUIRE(world.GetChunkCountY() == 3);
+    }
+
+    SECTION("Empty world has no awake chunks") {
+        world.Update();
+        for (int cy = 0; cy < world.GetChunkCountY(); cy++) {
+            for (int cx = 0; cx < world.GetChunkCountX(); cx++) {
+                REQUIRE_FALSE(world.IsChunkAwake(cx, cy));
+            }
+        }
+    }
+
+    SECTION("SetPixel wakes the chunk it writes to") {
+        world.SetPixel(10, 10, MaterialType::Sand);
+        REQUIRE(world.IsChunkAwake(0, 0));
+        REQUIRE_FALSE(world.IsChunkAwake(1, 0));
+    }
+
+    SECTION("Writing an edge cell wakes the neighbouring chunks") {
+        world.SetPixel(63, 63, MaterialType::Stone);
+        REQUIRE(world.IsChunkAwake(0, 0));
+        REQUIRE(world.IsChunkAwake(1, 0));
+        REQUIRE(world.IsChunkAwake(0, 1));
+        REQUIRE(world.IsChunkAwake(1, 1));
+        REQUIRE_FALSE(world.IsChunkAwake(2, 0));
+    }
+
+    SECTION("Settled chunks go back to sleep") {
+        for (int x = 0; x < 20; x++) {
+            world.SetPixel(x, 120, MaterialType::Stone);
+        }
+        world.SetPixel(10, 60, MaterialType::Sand);
+
+        for (int i = 0; i < 100; i++) {
+            world.Update();
+        }
+
+        REQUIRE(world.GetPixel(10, 119) == MaterialType::Sand);
+        REQUIRE_FALSE(world.IsChunkAwake(0, 0));
+        REQUIRE_FALSE(world.IsChunkAwake(0, 1));
+        REQUIRE_FALSE(world.IsChunkAwake(0, 2));
+    }
+
+    SECTION("Sand crosses chunk borders while falling") {
+        world.SetPixel(70, 0, MaterialType::Sand);
+
+        for (int i = 0; i < 200; i++) {
+            world.Update();
+        }
+
+        REQUIRE(world.GetPixel(70, 129) == MaterialType::Sand);
+    }
+
+    SECTION("Removing support wakes a sleeping pile") {
+        for (int x = 28; x <= 32; x++) {
+            world.SetPixel(x, 100, MaterialType::Stone);
+        }
+        world.SetPixel(30, 99, MaterialType::Sand);
+        for (int i = 0; i < 5; i++) {
+            world.Update();
+        }
+        REQUIRE_FALSE(world.IsChunkAwake(0, 1));
+
+        world.SetPixel(30, 100, MaterialType::Air);
+        world.Update();
+
+        REQUIRE(world.GetPixel(30, 100) == MaterialType::Sand);
+    }
+}
+
+TEST_CASE("World moves each cell at most once per tick", "[World][Clock]") {
+    World world(128, 16);
+    for (int x = 0; x < 128; x++) {
+        world.SetPixel(x, 15, MaterialType::Stone);
+    }
+
+    auto findWater = [&]() {
+        for (int x = 0; x < 128; x++) {
+            if (world.GetPixel(x, 14) == MaterialType::Water) return x;
+        }
+        return -1;
+    };
+
+    SECTION("Water spreads at most one cell sideways per tick") {
+        world.SetPixel(60, 14, MaterialType::Water);
+        int lastX = findWater();
+
+        for (int i = 0; i < 40; i++) {
+            world.Update();
+            int x = findWater();
+            REQUIRE(x >= 0);
+            REQUIRE(std::abs(x - lastX) <= 1);
+            lastX = x;
+        }
+    }
+
+    SECTION("Falling sand accelerates without skipping obstacles") {
+        World tall(64, 512);
+        tall.SetPixel(5, 0, MaterialType::Sand);
+        for (int x = 0; x < 64; x++) {
+            tall.SetPixel(x, 400, MaterialType::Stone);
+        }
+
+        auto findSand = [&]() {
+            for (int y = 0; y < 512; y++) {
+                if (tall.GetPixel(5, y) == MaterialType::Sand) return y;
+            }
+            return -1;
+        };
+
+        int lastY = 0;
+        int ticks = 0;
+        while (lastY != 399 && ticks < 400) {
+            tall.Update();
+            ticks++;
+            int y = findSand();
+            REQUIRE(y > lastY);
+            REQUIRE(y - lastY <= World::CHUNK_SIZE / 2);
+            lastY = y;
+        }
+
+        REQUIRE(lastY == 399);
+        REQUIRE(ticks < 100);
+
+        tall.Update();
+        REQUIRE(tall.GetPixel(5, 399) == MaterialType::Sand);
+        REQUIRE(tall.GetVelocityY(5, 399) == 0);
+    }
+
+    SECTION("A column of falling sand stays in order") {
+        World tall(64, 512);
+        for (int x = 0; x < 64; x++) {
+            tall.SetPixel(x, 511, MaterialType::Stone);
+        }
+        for (int y = 0; y < 20; y++) {
+            tall.SetPixel(5, y, MaterialType::Sand);
+        }
+
+        for (int i = 0; i < 200; i++) {
+            tall.Update();
+        }
+
+        int sand = 0;
+        for (int y = 0; y < 512; y++) {
+            for (int x = 0; x < 64; x++) {
+                if (tall.GetPixel(x, y) == MaterialType::Sand) sand++;
+            }
+        }
+        REQUIRE(sand == 20);
+        REQUIRE(tall.GetPixel(5, 510) == MaterialType::Sand);
+    }
+}
+
+TEST_CASE("World dirty rectangles", "[World][Chunks]") {
+    SECTION("A settled world scans nothing") {
+        World world(256, 256);
+        world.Update();
+        REQUIRE(world.GetCellsScannedLastUpdate() == 0);
+    }
+
+    SECTION("A falling stream only scans cells around the stream") {
+        World world(2048, 2048);
+        for (int i = 0; i < 50; i++) {
+            world.SetPixel(1000, 0, MaterialType::Sand);
+            world.Update();
+        }
+
+        REQUIRE(world.GetCellsScannedLastUpdate() > 0);
+        REQUIRE(world.GetCellsScannedLastUpdate() < 5000);
+    }
+
+    SECTION("A move across a chunk border extends the neighbour's rect") {
+        World world(128, 128);
+        world.SetPixel(10, 62, MaterialType::Sand);
+
+        for (int i = 0; i < 4; i++) {
+            world.Update();
+        }
+
+        REQUIRE(world.GetPixel(10, 66) == MaterialType::Sand);
+        REQUIRE(world.IsChunkAwake(0, 1));
+        REQUIRE_FALSE(world.IsChunkAwake(1, 1));
+    }
+}
+
+TEST_CASE("World multi-threaded update", "[World][Threading]") {
+    World world(256, 256);
+    world.SetThreadCount(4);
+    REQUIRE(world.GetThreadCount() == 4);
+
+    for (int x = 0; x < 256; x++) {
+        world.SetPixel(x, 255, MaterialType::Stone);
+    }
+    for (int y = 0; y < 100; y++) {
+        for (int x = 20; x < 236; x += 2) {
+            world.SetPixel(x, y, (y % 2) ? MaterialType::Sand : MaterialType::Water);
+        }
+    }
+
+    auto countMaterial = [&](MaterialType material) {
+        int count = 0;
+        for (int y = 0; y < 256; y++) {
+            for (int x = 0; x < 256; x++) {
+                if (world.GetPixel(x, y) == material) count++;
+            }
+        }
+        return count;
+    };
+
+    int sand = countMaterial(MaterialType::Sand);
+    int water = countMaterial(MaterialType::Water);
+
+    for (int i = 0; i < 300; i++) {
+        world.Update();
+    }
+
+    SECTION("Parallel update conserves every material") {
+        REQUIRE(countMaterial(MaterialType::Sand) == sand);
+        REQUIRE(countMaterial(MaterialType::Water) == water);
+        REQUIRE(countMaterial(MaterialType::Stone) == 256);
+    }
+
+    SECTION("Everything has fallen to the bottom half") {
+        for (int y = 0; y < 100; y++) {
+            for (int x = 0; x < 256; x++) {
+                REQUIRE(world.GetPixel(x, y) == MaterialType::Air);
+            }
+        }
+    }
+}
+
+TEST_CASE("World settled cells sleep", "[World][Sleep]") {
+    World world(64, 64);
+    for (int x = 0; x < 64; x++) {
+        world.SetPixel(x, 63, MaterialType::Stone);
+        for (int y = 40; y < 63; y++) {
+            world.SetPixel(x, y, MaterialType::Sand);
+        }
+    }
+
+    // Toggling two far corners keeps the whole pile inside the dirty rect
+    auto touchCorners = [&](int tick) {
+        MaterialType material = (tick % 2) ? MaterialType::Stone : MaterialType::Sand;
+        world.SetPixel(0, 62, material);
+        world.SetPixel(63, 40, material);
+    };
+
+    SECTION("A resting pile stops running kernels") {
+        for (int tick = 0; tick < 6; tick++) {
+            touchCorners(tick);
+            world.Update();
+        }
+
+        REQUIRE(world.GetCellsScannedLastUpdate() > 1000);
+        REQUIRE(world.GetCellsUpdatedLastUpdate() <= 8);
+    }
+
+    SECTION("Removing support wakes sleeping cells") {
+        for (int tick = 0; tick < 6; tick++) {
+            touchCorners(tick);
+            world.Update();
+        }
+
+        world.SetPixel(30, 62, MaterialType::Air);
+        world.Update();
+
+        // Each grain that moves wakes the ones above it, so the hole climbs
+        // to the top of the pile within the tick
+        REQUIRE(world.GetPixel(30, 62) == MaterialType::Sand);
+        int topHoles = 0;
+        for (int x = 0; x < 64; x++) {
+            if (world.GetPixel(x, 40) == MaterialType::Air) topHoles++;
+        }
+        REQUIRE(topHoles == 1);
+    }
+}
+
+TEST_CASE("World cell lanes", "[World][Lanes]") {
+    World world(16, 16);
+    for (int x = 0; x < 16; x++) {
+        world.SetPixel(x, 15, MaterialType::Stone);
+    }
+
+    SECTION("Unwritten lanes read their defaults") {
+        REQUIRE(world.GetVelocityX(3, 3) == 0);
+        REQUIRE(world.GetVelocityY(3, 3) == 0);
+        REQUIRE(world.GetVelocityX(-1, 3) == 0);
+    }
+
+    SECTION("Lane values travel with their cell") {
+        world.SetPixel(4, 0, MaterialType::Sand);
+        world.SetVelocity(4, 0, -2, 5);
+
+        for (int i = 0; i < 20; i++) {
+            world.Update();
+        }
+
+        REQUIRE(world.GetPixel(4, 14) == MaterialType::Sand);
+        REQUIRE(world.GetVelocityX(4, 14) == -2);
+        REQUIRE(world.GetVelocityX(4, 0) == 0);
+    }
+
+    SECTION("SetPixel and Clear reset lanes") {
+        world.SetVelocity(2, 2, 3, 3);
+        world.SetPixel(2, 2, MaterialType::Water);
+        REQUIRE(world.GetVelocityX(2, 2) == 0);
+
+        world.SetVelocity(5, 5, 4, 0);
+        world.Clear();
+        REQUIRE(world.GetVelocityX(5, 5) == 0);
+    }
+}
+
+TEST_CASE("World liquid levelling", "[World][Leveling]") {
+    auto surfaceRange = [](const World& world, int x0, int x1) {
+        int highest = world.GetHeight();
+        int lowest = -1;
+        for (int x = x0; x <= x1; x++) {
+            int y = 0;
+            while (y < world.GetHeight() && world.GetPixel(x, y) != MaterialType::Water) y++;
+            highest = std::min(highest, y);
+            lowest = std::max(lowest, y);
+        }
+        return lowest - highest;
+    };
+
+    SECTION("A wide lake levels within a few passes") {
+        World world(512, 64);
+        REQUIRE(world.GetLevelingInterval() == World::DEFAULT_LEVELING_INTERVAL);
+        for (int x = 0; x < 512; x++) {
+            world.SetPixel(x, 63, MaterialType::Stone);
+            for (int y = 58; y < 63; y++) {
+                world.SetPixel(x, y, MaterialType::Water);
+            }
+        }
+        // Exactly one more row's worth of water, so the lake can come to rest
+        for (int y = 26; y < 58; y++) {
+            for (int x = 248; x < 264; x++) {
+                world.SetPixel(x, y, MaterialType::Water);
+            }
+        }
+
+        World unlevelled(512, 64);
+        unlevelled.SetLevelingInterval(0);
+        for (int y = 0; y < 64; y++) {
+            for (int x = 0; x < 512; x++) {
+                unlevelled.SetPixel(x, y, world.GetPixel(x, y));
+            }
+        }
+
+        for (int i = 0; i < 80; i++) {
+            world.Update();
+            unlevelled.Update();
+        }
+
+        REQUIRE(surfaceRange(world, 0, 511) <= 1);
+        REQUIRE(surfaceRange(unlevelled, 0, 511) > 1);
+
+        for (int i = 0; i < 20; i++) {
+            world.Update();
+        }
+        REQUIRE(world.GetCellsUpdatedLastUpdate() == 0);
+    }
+
+    SECTION("Communicating vessels reach the same level") {
+        // Two arms joined by a pipe along the bottom of a stone block
+        World world(64, 64);
+        for (int y = 0; y < 64; y++) {
+            for (int x = 0; x < 64; x++) {
+                bool leftArm = x >= 10 && x < 16 && y < 60;
+                bool rightArm = x >= 40 && x < 46 && y < 60;
+                bool pipe = x >= 10 && x < 46 && y >= 60 && y < 63;
+                world.SetPixel(x, y, leftArm || rightArm || pipe ? MaterialType::Air : MaterialType::Stone);
+            }
+        }
+        for (int y = 10; y < 60; y++) {
+            for (int x = 10; x < 16; x++) {
+                world.SetPixel(x, y, MaterialType::Water);
+            }
+        }
+
+        for (int i = 0; i < 200; i++) {
+            world.Update();
+        }
+
+        int left = 0;
+        while (world.GetPixel(12, left) != MaterialType::Water) left++;
+        int right = 0;
+        while (world.GetPixel(42, right) != MaterialType::Water) right++;
+        REQUIRE(std::abs(left - right) <= 1);
+        REQUIRE(left > 20);
+    }
+
+    SECTION("A falling blob falls at its normal speed across levelling ticks") {
+        World world(64, 512);
+        World unlevelled(64, 512);
+        unlevelled.SetLevelingInterval(0);
+        for (World* w : {&world, &unlevelled}) {
+            w->FillRect(27, 10, 36, 19, MaterialType::Water);
+        }
+
+        for (int i = 0; i < 3 * World::DEFAULT_LEVELING_INTERVAL; i++) {
+            world.Update();
+            unlevelled.Update();
+            for (int y = 0; y < 512; y++) {
+                for (int x = 0; x < 64; x++) {
+                    REQUIRE(world.GetPixel(x, y) == unlevelled.GetPixel(x, y));
+                }
+            }
+        }
+        REQUIRE(world.GetPixel(31, 511) == MaterialType::Air);
+    }
+}
+
+TEST_CASE("World heat and phase changes", "[World][Fields]") {
+    World world(64, 64);
+    for (int x = 0; x < 64; x++) {
+        world.SetPixel(x, 63, MaterialType::Stone);
+    }
+
+    SECTION("The heat field starts at ambient") {
+        REQUIRE(world.GetFields().Find(World::HEAT_FIELD) != nullptr);
+        REQUIRE(world.GetHeat(10, 10) == Catch::Approx(World::AMBIENT_TEMPERATURE));
+    }
+
+    SECTION("Heated water boils into rising steam") {
+        for (int x = 20; x < 28; x++) {
+            world.SetPixel(x, 62, MaterialType::Water);
+        }
+        world.Update();
+        world.AddHeat(24, 62, 5000.0f);
+
+        world.Update();
+        int steam = 0;
+        for (int x = 20; x < 28; x++) {
+            if (world.GetPixel(x, 62) == MaterialType::Steam) steam++;
+        }
+        REQUIRE(steam > 0);
+
+        for (int i = 0; i < 10; i++) {
+            world.Update();
+        }
+        bool risen = false;
+        for (int y = 0; y < 58; y++) {
+            for (int x = 0; x < 64; x++) {
+                if (world.GetPixel(x, y) == MaterialType::Steam) risen = true;
+            }
+        }
+        REQUIRE(risen);
+    }
+
+    SECTION("Steam condenses in cool air") {
+        world.SetPixel(30, 40, MaterialType::Steam);
+        world.Update();
+
+        int steam = 0;
+        for (int y = 0; y < 64; y++) {
+            for (int x = 0; x < 64; x++) {
+                if (world.GetPixel(x, y) == MaterialType::Steam) steam++;
+            }
+        }
+        REQUIRE(steam == 0);
+    }
+
+    SECTION("Steam trapped under a ceiling condenses once the heat fades") {
+        for (int x = 0; x < 64; x++) {
+            world.SetPixel(x, 10, MaterialType::Stone);
+            world.SetPixel(x, 38, MaterialType::Water);
+            world.SetPixel(x, 39, MaterialType::Water);
+        }
+        for (int i = 0; i < 60; i++) {
+            for (int x = 0; x < 64; x += World::FIELD_CELL_SIZE) {
+                world.AddHeat(x, 38, 200.0f);
+            }
+            world.Update();
+        }
+        auto count = [&](MaterialType material) {
+            int cells = 0;
+            for (int y = 0; y < 64; y++) {
+                for (int x = 0; x < 64; x++) {
+                    if (world.GetPixel(x, y) == material) cells++;
+                }
+            }
+            return cells;
+        };
+        REQUIRE(count(MaterialType::Steam) > 0);
+
+        for (int i = 0; i < 600; i++) {
+            world.Update();
+        }
+
+        REQUIRE(count(MaterialType::Steam) == 0);
+        REQUIRE(count(MaterialType::Water) == 128);
+    }
+}
+
+TEST_CASE("World material reactions", "[World][Reactions]") {
+    World world(128, 64);
+    for (int x = 0; x < 128; x++) {
+        world.SetPixel(x, 63, MaterialType::Stone);
+    }
+
+    auto count = [&](MaterialType material) {
+        int cells = 0;
+        for (int y = 0; y < 64; y++) {
+            for (int x = 0; x < 128; x++) {
+                if (world.GetPixel(x, y) == material) cells++;
+            }
+        }
+        return cells;
+    };
+
+    SECTION("Chunk material counts follow every write") {
+        REQUIRE(world.GetChunkMaterialCount(0, 0, MaterialType::Stone) == 64);
+        REQUIRE(world.GetChunkMaterialCount(1, 0, MaterialType::Air) == 64 * 63);
+
+        // Sand falling across the chunk border moves between the counts
+        world.SetPixel(64, 10, MaterialType::Sand);
+        REQUIRE(world.GetChunkMaterialCount(1, 0, MaterialType::Sand) == 1);
+        for (int i = 0; i < 80; i++) {
+            world.Update();
+        }
+        REQUIRE(world.GetChunkMaterialCount(1, 0, MaterialType::Sand) == 1);
+
+        world.Clear();
+        REQUIRE(world.GetChunkMaterialCount(1, 0, MaterialType::Sand) == 0);
+        REQUIRE(world.GetChunkMaterialCount(1, 0, MaterialType::Air) == 64 * 64);
+    }
+
+    SECTION("Lava meeting water hardens into stone") {
+        for (int x = 40; x < 50; x++) {
+            world.SetPixel(x, 62, MaterialType::Water);
+            world.SetPixel(x, 61, MaterialType::Lava);
+        }
+        int stone = count(MaterialType::Stone);
+
+        for (int i = 0; i < 200; i++) {
+            world.Update();
+        }
+        REQUIRE(count(MaterialType::Lava) == 0);
+        REQUIRE(count(MaterialType::Stone) == stone + 10);
+    }
+
+    SECTION("A pending reaction keeps its chunk awake") {
+        // Stone walls hold the pair still, so only the reaction can change it
+        for (int y = 61; y <= 62; y++) {
+            world.SetPixel(9, y, MaterialType::Stone);
+            world.SetPixel(11, y, MaterialType::Stone);
+        }
+        world.SetPixel(10, 62, MaterialType::Lava);
+        world.SetPixel(10, 61, MaterialType::Water);
+
+        for (int i = 0; i < 200 && world.GetPixel(10, 62) == MaterialType::Lava; i++) {
+            world.Update();
+        }
+        REQUIRE(world.GetPixel(10, 62) == MaterialType::Stone);
+    }
+
+    SECTION("Chunks without both sides of a rule are not checked") {
+        World wide(256, 64);
+        for (int x = 0; x < 128; x++) {
+            wide.SetPixel(x, 30, MaterialType::Water);
+            wide.SetPixel(x, 20, MaterialType::Sand);
+        }
+        // Two chunks away from any water
+        wide.SetPixel(220, 40, MaterialType::Lava);
+
+        wide.Update();
+        REQUIRE(wide.GetCellsUpdatedLastUpdate() > 0);
+        REQUIRE(wide.GetCellsReactionCheckedLastUpdate() == 0);
+
+        wide.SetPixel(221, 40, MaterialType::Water);
+        wide.Update();
+        REQUIRE(wide.GetCellsReactionCheckedLastUpdate() > 0);
+    }
+}
+
+TEST_CASE("World timed transitions", "[World][Timers]") {
+    World world(128, 64);
+    for (int x = 0; x < 128; x++) {
+        world.SetPixel(x, 63, MaterialType::Stone);
+    }
+
+    SECTION("A timer counts down and replaces the cell") {
+        world.SetPixel(10, 62, MaterialType::Sand);
+        world.SetTimer(10, 62, 5);
+        REQUIRE(world.GetTimer(10, 62) == 5);
+
+        world.Update();
+        REQUIRE(world.GetTimer(10, 62) == 4);
+        for (int i = 0; i < 3; i++) {
+            world.Update();
+        }
+        REQUIRE(world.GetPixel(10, 62) == MaterialType::Sand);
+        world.Update();
+        REQUIRE(world.GetPixel(10, 62) == MaterialType::Air);
+        REQUIRE(world.GetTimer(10, 62) == 0);
+    }
+
+    SECTION("Timers follow moving cells") {
+        world.SetPixel(20, 0, MaterialType::Sand);
+        world.SetTimer(20, 0, 40);
+        for (int i = 0; i < 39; i++) {
+            world.Update();
+        }
+        REQUIRE(world.GetPixel(20, 62) == MaterialType::Sand);
+        REQUIRE(world.GetTimer(20, 62) == 1);
+
+        world.Update();
+        REQUIRE(world.GetPixel(20, 62) == MaterialType::Air);
+    }
+
+    SECTION("Timed cells pushed aside keep their timers") {
+        for (int y = 55; y < 63; y++) {
+            world.SetPixel(2, y, MaterialType::Stone);
+            world.SetPixel(4, y, MaterialType::Stone);
+        }
+        world.SetPixel(3, 62, MaterialType::Water);
+        world.SetTimer(3, 62, 10);
+        world.SetPixel(3, 61, MaterialType::Sand);
+
+        world.Update();
+        REQUIRE(world.GetPixel(3, 61) == MaterialType::Water);
+        REQUIRE(world.GetTimer(3, 61) == 9);
+        for (int i = 0; i < 8; i++) {
+            world.Update();
+        }
+        REQUIRE(world.GetPixel(3, 61) == MaterialType::Water);
+        world.Update();
+        REQUIRE(world.GetPixel(3, 61) == MaterialType::Air);
+        REQUIRE(world.GetPixel(3, 62) == MaterialType::Sand);
+        REQUIRE(world.GetTimer(3, 61) == 0);
+    }
+
+    SECTION("Fire that sand sinks through still burns out") {
+        for (int y = 55; y < 63; y++) {
+            world.SetPixel(6, y, MaterialType::Stone);
+            world.SetPixel(8, y, MaterialType::Stone);
+        }
+        world.SetPixel(7, 62, MaterialType::Fire);
+        world.SetPixel(7, 61, MaterialType::Sand);
+        int lifetime = world.GetTimer(7, 62);
+
+        for (int i = 0; i < lifetime; i++) {
+            world.Update();
+        }
+        REQUIRE(world.GetPixel(7, 62) == MaterialType::Sand);
+        for (int y = 0; y < 62; y++) {
+            REQUIRE(world.GetPixel(7, y) != MaterialType::Fire);
+        }
+    }
+
+    SECTION("Sleeping cells still expire") {
+        world.SetPixel(30, 62, MaterialType::Sand);
+        world.SetTimer(30, 62, 20);
+        for (int i = 0; i < 19; i++) {
+            world.Update();
+        }
+        REQUIRE_FALSE(world.IsChunkAwake(0, 0));
+        world.Update();
+        REQUIRE(world.GetPixel(30, 62) == MaterialType::Air);
+    }
+
+    SECTION("Replacing or cancelling drops the timer") {
+        world.SetPixel(40, 62, MaterialType::Sand);
+        world.SetTimer(40, 62, 3);
+        world.SetPixel(40, 62, MaterialType::Water);
+        world.SetPixel(50, 62, MaterialType::Sand);
+        world.SetTimer(50, 62, 3);
+        world.SetTimer(50, 62, 0);
+
+        for (int i = 0; i < 5; i++) {
+            world.Update();
+        }
+        REQUIRE(world.GetPixel(50, 62) == MaterialType::Sand);
+        REQUIRE(world.GetTimer(50, 62) == 0);
+        REQUIRE(world.GetTimersDueLastUpdate() == 0);
+    }
+
+    SECTION("Fire burns out without a timer being set") {
+        for (int x = 60; x < 70; x++) {
+            world.SetPixel(x, 40, MaterialType::Fire);
+        }
+        REQUIRE(world.GetTimer(60, 40) >= TIMED_TRANSITIONS[static_cast<int>(MaterialType::Fire)].lifetime);
+
+        for (int i = 0; i < 100; i++) {
+            world.Update();
+        }
+        for (int y = 0; y < 64; y++) {
+            for (int x = 0; x < 128; x++) {
+                REQUIRE(world.GetPixel(x, y) != MaterialType::Fire);
+            }
+        }
+    }
+
+    SECTION("Only due timers are processed") {
+        for (int x = 0; x < 128; x++) {
+            for (int y = 30; y < 62; y++) {
+                world.SetPixel(x, y, MaterialType::Sand);
+                world.SetTimer(x, y, 1000);
+            }
+        }
+        world.SetTimer(5, 5, 2);
+
+        world.Update();
+        REQUIRE(world.GetTimersDueLastUpdate() == 0);
+        world.Update();
+        REQUIRE(world.GetTimersDueLastUpdate() == 1);
+    }
+}
+
+namespace {
+
+void FillTestScene(World& world) {
+    for (int x = 0; x < world.GetWidth(); x++) {
+        world.SetPixel(x, world.GetHeight() - 1, MaterialType::Stone);
+    }
+    for (int y = 0; y < 80; y++) {
+        for (int x = 30; x < world.GetWidth() - 30; x++) {
+            if ((x * 7 + y * 3) % 5 == 0) {
+                world.SetPixel(x, y, (x + y) % 3 ? MaterialType::Sand : MaterialType::Water);
+            }
+        }
+    }
+}
+
+bool SameCells(const World& a, const World& b) {
+    for (int y = 0; y < a.GetHeight(); y++) {
+        for (int x = 0; x < a.GetWidth(); x++) {
+            if (a.GetPixel(x, y) != b.GetPixel(x, y)) return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("World deterministic randomness", "[World][Random]") {
+    World serial(200, 200);
+    World parallel(200, 200);
+    serial.SetSeed(1234);
+    parallel.SetSeed(1234);
+    parallel.SetThreadCount(4);
+    FillTestScene(serial);
+    FillTestScene(parallel);
+
+    SECTION("Same seed gives the same world for any thread count") {
+        for (int i = 0; i < 150; i++) {
+            serial.Update();
+            parallel.Update();
+        }
+        REQUIRE(serial.GetTick() == 150);
+        REQUIRE(SameCells(serial, parallel));
+    }
+
+    SECTION("Different seeds diverge") {
+        World other(200, 200);
+        other.SetSeed(99);
+        FillTestScene(other);
+        for (int i = 0; i < 150; i++) {
+            serial.Update();
+            other.Update();
+        }
+        REQUIRE_FALSE(SameCells(serial, other));
+    }
+}
+
+TEST_CASE("World powder bit planes", "[World][BitPlanes]") {
+    SECTION("Straight falls match the per-cell rules") {
+        World cells(150, 100);
+        World planes(150, 100);
+        planes.SetPowderBitPlanes(true);
+        REQUIRE(planes.HasPowderBitPlanes());
+
+        for (World* world : {&cells, &planes}) {
+            for (int x = 0; x < 150; x++) {
+                world->SetPixel(x, 99, MaterialType::Stone);
+                world->SetPixel(x, (x * 13) % 90, MaterialType::Sand);
+            }
+        }
+
+        for (int i = 0; i < 100; i++) {
+            cells.Update();
+            planes.Update();
+            REQUIRE(SameCells(cells, planes));
+        }
+        for (int x = 0; x < 150; x++) {
+            REQUIRE(planes.GetPixel(x, 98) == MaterialType::Sand);
+        }
+    }
+
+    SECTION("Dense piles match the per-cell rules") {
+        // Grains that slide diagonally or flow sideways within a row meet
+        // grains falling straight from the same row
+        World cells(300, 260);
+        World planes(300, 260);
+        planes.SetPowderBitPlanes(true);
+
+        for (World* world : {&cells, &planes}) {
+            for (int x = 0; x < 300; x++) {
+                world->SetPixel(x, 259, MaterialType::Stone);
+            }
+            for (int y = 100; y < 106; y++) {
+                for (int x = 20; x < 31; x++) {
+                    world->SetPixel(x, y, MaterialType::Sand);
+                }
+            }
+            for (int y = 0; y < 250; y++) {
+                for (int x = 100; x < 300; x++) {
+                    uint32_t roll = ((uint32_t(x) * 73856093u) ^ (uint32_t(y) * 19349663u)) % 10;
+                    if (roll < 4) {
+                        world->SetPixel(x, y, MaterialType::Sand);
+                    } else if (roll == 4) {
+                        world->SetPixel(x, y, MaterialType::Water);
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < 150; i++) {
+            cells.Update();
+            planes.Update();
+            INFO("tick " << i);
+            REQUIRE(SameCells(cells, planes));
+            REQUIRE(cells.GetStateHash() == planes.GetStateHash());
+        }
+    }
+
+    SECTION("Lanes and timers fall with their grains") {
+        World cells(100, 64);
+        World planes(100, 64);
+        planes.SetPowderBitPlanes(true);
+
+        for (World* world : {&cells, &planes}) {
+            for (int x = 0; x < 100; x++) {
+                world->SetPixel(x, 63, MaterialType::Stone);
+                world->SetPixel(x, 10 + x % 7, MaterialType::Sand);
+                world->SetVelocity(x, 10 + x % 7, x % 5 - 2, 0);
+                world->SetTimer(x, 10 + x % 7, 200 + x);
+            }
+        }
+
+        for (int i = 0; i < 60; i++) {
+            cells.Update();
+            planes.Update();
+        }
+
+        REQUIRE(SameCells(cells, planes));
+        for (int x = 0; x < 100; x++) {
+            REQUIRE(planes.GetPixel(x, 62) == MaterialType::Sand);
+            REQUIRE(planes.GetVelocityX(x, 62) == cells.GetVelocityX(x, 62));
+            REQUIRE(planes.GetTimer(x, 62) == cells.GetTimer(x, 62));
+            REQUIRE(planes.GetTimer(x, 62) == 140 + x);
+        }
+    }
+
+    SECTION("Grains still slide diagonally into piles") {
+        World world(32, 32);
+        world.SetPowderBitPlanes(true);
+        for (int x = 0; x < 32; x++) {
+            world.SetPixel(x, 31, MaterialType::Stone);
+        }
+        for (int y = 0; y < 10; y++) {
+            world.SetPixel(16, y, MaterialType::Sand);
+        }
+
+        for (int i = 0; i < 100; i++) {
+            world.Update();
+        }
+
+        REQUIRE(world.GetPixel(16, 21) == MaterialType::Air);
+        REQUIRE(world.GetPixel(15, 30) == MaterialType::Sand);
+        REQUIRE(world.GetPixel(17, 30) == MaterialType::Sand);
+    }
+
+    SECTION("Mixed scenes conserve material and stay thread-count independent") {
+        World serial(200, 200);
+        World parallel(200, 200);
+        serial.SetPowderBitPlanes(true);
+        parallel.SetPowderBitPlanes(true);
+        parallel.SetThreadCount(4);
+        FillTestScene(serial);
+        FillTestScene(parallel);
+
+        auto countSand = [&]() {
+            int count = 0;
+            for (int y = 0; y < 200; y++) {
+                for (int x = 0; x < 200; x++) {
+                    if (serial.GetPixel(x, y) == MaterialType::Sand) count++;
+                }
+            }
+            return count;
+        };
+        int sand = countSand();
+
+        for (int i = 0; i < 150; i++) {
+            serial.Update();
+            parallel.Update();
+        }
+
+        REQUIRE(countSand() == sand);
+        REQUIRE(SameCells(serial, parallel));
+    }
+}
+
+TEST_CASE("World sparse storage", "[World][Sparse]") {
+    SECTION("Sparse and dense worlds evolve identically") {
+        World dense(256, 256);
+        World sparse(256, 256, WorldStorage::Sparse);
+        sparse.SetThreadCount(4);
+        REQUIRE(sparse.IsSparse());
+        FillTestScene(dense);
+        FillTestScene(sparse);
+
+        for (int i = 0; i < 150; i++) {
+            dense.Update();
+            sparse.Update();
+        }
+
+        REQUIRE(SameCells(dense, sparse));
+    }
+
+    SECTION("Sparse worlds have no heat field and reject heat") {
+        World dense(128, 128);
+        World sparse(128, 128, WorldStorage::Sparse);
+        REQUIRE(dense.HasFields());
+        REQUIRE_FALSE(sparse.HasFields());
+        REQUIRE(sparse.GetFields().Find(World::HEAT_FIELD) == nullptr);
+
+        REQUIRE(dense.AddHeat(40, 40, 500.0f));
+        REQUIRE_FALSE(sparse.AddHeat(40, 40, 500.0f));
+        REQUIRE(sparse.GetHeat(40, 40) == Catch::Approx(World::AMBIENT_TEMPERATURE));
+        REQUIRE_FALSE(dense.AddHeat(-1, 40, 500.0f));
+    }
+
+    SECTION("Empty space costs no storage") {
+        World world(1000000, 1000000, WorldStorage::Sparse);
+        REQUIRE(world.GetAllocatedChunkCount() == 0);
+        REQUIRE(world.GetPixel(123456, 654321) == MaterialType::Air);
+        world.SetPixel(123456, 654321, MaterialType::Air);
+        REQUIRE(world.GetAllocatedChunkCount() == 0);
+
+        for (int x = 500000; x < 500064; x++) {
+            world.SetPixel(x, 999999, MaterialType::Stone);
+        }
+        for (int y = 999900; y < 999920; y++) {
+            for (int x = 500020; x < 500040; x++) {
+                world.SetPixel(x, y, MaterialType::Sand);
+            }
+        }
+
+        for (int i = 0; i < 200; i++) {
+            world.Update();
+        }
+
+        int sand = 0;
+        for (int y = 999800; y < 1000000; y++) {
+            for (int x = 499900; x < 500200; x++) {
+                if (world.GetPixel(x, y) == MaterialType::Sand) sand++;
+            }
+        }
+        REQUIRE(sand == 400);
+        REQUIRE(world.GetAllocatedChunkCount() <= 8);
+    }
+
+    SECTION("Chunks that empty out are released") {
+        World world(512, 512, WorldStorage::Sparse);
+        for (int x = 200; x < 220; x++) {
+            world.SetPixel(x, 300, MaterialType::Fire);
+        }
+        REQUIRE(world.GetAllocatedChunkCount() > 0);
+
+        for (int i = 0; i < 200; i++) {
+            world.Update();
+        }
+
+        REQUIRE(world.GetAllocatedChunkCount() == 0);
+        REQUIRE(world.GetChunkMaterialCount(3, 4, MaterialType::Air) == 64 * 64);
+    }
+
+    SECTION("Released chunk blocks are reused") {
+        World world(512, 512, WorldStorage::Sparse);
+        world.SetPixel(500, 500, MaterialType::Stone);
+        size_t blocks = 0;
+        for (int round = 0; round < 3; round++) {
+            // Burns out and is released while the stone's chunk stays
+            for (int x = 200; x < 220; x++) {
+                world.SetPixel(x, 300 - round * 64, MaterialType::Fire);
+            }
+            for (int i = 0; i < 200; i++) {
+                world.Update();
+            }
+            if (round == 0) {
+                blocks = world.GetStorageBlockCount();
+            }
+            REQUIRE(world.GetStorageBlockCount() == blocks);
+            REQUIRE(world.GetAllocatedChunkCount() == 1);
+            REQUIRE(world.GetPixel(500, 500) == MaterialType::Stone);
+        }
+
+        // A reused block reads as fresh cells
+        world.SetPixel(100, 100, MaterialType::Sand);
+        REQUIRE(world.GetStorageBlockCount() == blocks);
+        REQUIRE(world.GetPixel(101, 100) == MaterialType::Air);
+        REQUIRE(world.GetVelocityY(101, 100) == 0);
+        REQUIRE(world.GetTimer(101, 100) == 0);
+    }
+
+    SECTION("Storage shrinks once the active area does") {
+        World world(1024, 1024, WorldStorage::Sparse);
+        world.FillRect(0, 0, 1023, 767, MaterialType::Stone);
+        // Allocated after the fill, so its block sits past the packed front
+        world.SetPixel(1000, 1000, MaterialType::Stone);
+        world.SetVelocity(1000, 1000, 3, 0);
+        world.SetTimer(1000, 1000, 500);
+        world.Update();
+        size_t bytes = world.GetStorageBytes();
+        REQUIRE(world.GetStorageBlockCount() > 192);
+
+        world.FillRect(0, 0, 1023, 767, MaterialType::Air);
+        for (int i = 0; i < 4; i++) {
+            world.Update();
+        }
+
+        REQUIRE(world.GetAllocatedChunkCount() == 1);
+        REQUIRE(world.GetStorageBlockCount() == 1);
+        REQUIRE(world.GetStorageBytes() * 16 < bytes);
+        REQUIRE(world.GetPixel(1000, 1000) == MaterialType::Stone);
+        REQUIRE(world.GetVelocityX(1000, 1000) == 3);
+        REQUIRE(world.GetTimer(1000, 1000) == 495);
+        REQUIRE(world.GetChunkMaterialCount(15, 15, MaterialType::Stone) == 1);
+
+        // Storage grows again on demand
+        world.FillRect(0, 0, 1023, 127, MaterialType::Sand);
+        REQUIRE(world.GetAllocatedChunkCount() == 33);
+        REQUIRE(world.GetPixel(500, 100) == MaterialType::Sand);
+        REQUIRE(world.GetPixel(1000, 1000) == MaterialType::Stone);
+    }
+
+    SECTION("Clear releases every chunk") {
+        World world(512, 512, WorldStorage::Sparse);
+        FillTestScene(world);
+        world.Update();
+        REQUIRE(world.GetAllocatedChunkCount() > 0);
+
+        world.Clear();
+        REQUIRE(world.GetAllocatedChunkCount() == 0);
+        REQUIRE(world.GetPixel(100, 10) == MaterialType::Air);
+    }
+}
+
+TEST_CASE("World focus level of detail", "[World][LOD]") {
+    World world(640, 128);
+
+    SECTION("Chunk intervals follow the distance to the focus") {
+        REQUIRE(world.GetChunkUpdateInterval(9, 1) == 1);
+
+        world.AddFocusRect(0, 0, 100, 63);
+        world.SetFocusMargin(2);
+        REQUIRE(world.GetChunkUpdateInterval(0, 0) == 1);
+        REQUIRE(world.GetChunkUpdateInterval(1, 0) == 1);
+        REQUIRE(world.GetChunkUpdateInterval(1, 1) == 2);
+        REQUIRE(world.GetChunkUpdateInterval(3, 1) == 2);
+        REQUIRE(world.GetChunkUpdateInterval(4, 0) == World::DEFAULT_DISTANT_INTERVAL);
+
+        world.SetDistantInterval(0);
+        REQUIRE(world.GetChunkUpdateInterval(9, 1) == 0);
+
+        world.AddFocusRect(600, 100, 639, 127);
+        REQUIRE(world.GetChunkUpdateInterval(9, 1) == 1);
+
+        world.ClearFocusRects();
+        REQUIRE(world.GetChunkUpdateInterval(5, 0) == 1);
+    }
+
+    SECTION("Distant chunks update at their interval") {
+        world.AddFocusRect(0, 0, 63, 63);
+        world.SetFocusMargin(0);
+        world.SetDistantInterval(4);
+        for (int x = 0; x < 640; x++) {
+            world.SetPixel(x, 127, MaterialType::Stone);
+        }
+        world.SetPixel(10, 0, MaterialType::Sand);
+        world.SetPixel(330, 0, MaterialType::Sand);
+
+        int nearMoves = 0;
+        int farMoves = 0;
+        int nearY = 0;
+        int farY = 0;
+        for (int i = 0; i < 8; i++) {
+            world.Update();
+            int y = 0;
+            while (world.GetPixel(10, y) != MaterialType::Sand) y++;
+            nearMoves += y != nearY;
+            nearY = y;
+            y = 0;
+            while (world.GetPixel(330, y) != MaterialType::Sand) y++;
+            farMoves += y != farY;
+            farY = y;
+        }
+
+        REQUIRE(nearMoves == 8);
+        REQUIRE(farMoves == 2);
+        REQUIRE(world.GetChunksDeferredLastUpdate() > 0);
+    }
+
+    SECTION("Frozen chunks catch up when they come back into focus") {
+        World reference(640, 128);
+        world.AddFocusRect(0, 0, 63, 63);
+        world.SetDistantInterval(0);
+        world.SetPixel(330, 2, MaterialType::Sand);
+        reference.SetPixel(330, 2, MaterialType::Sand);
+
+        for (int i = 0; i < 4; i++) {
+            world.Update();
+        }
+        REQUIRE(world.GetPixel(330, 2) == MaterialType::Sand);
+
+        world.ClearFocusRects();
+        world.Update();
+        world.Update();
+        for (int i = 0; i < 6; i++) {
+            reference.Update();
+        }
+
+        for (int y = 0; y < 64; y++) {
+            REQUIRE(world.GetPixel(330, y) == reference.GetPixel(330, y));
+        }
+        REQUIRE(world.GetChunksDeferredLastUpdate() == 0);
+    }
+
+    SECTION("Reactions in frozen chunks wait and are replayed with the catch-up") {
+        world.AddFocusRect(0, 0, 63, 63);
+        world.SetDistantInterval(0);
+        world.FillRect(320, 127, 339, 127, MaterialType::Stone);
+        world.FillRect(320, 126, 339, 126, MaterialType::Lava);
+        world.FillRect(320, 125, 339, 125, MaterialType::Water);
+
+        for (int i = 0; i < 8; i++) {
+            world.Update();
+            REQUIRE(world.GetCellsReactionCheckedLastUpdate() == 0);
+        }
+        REQUIRE(world.GetChunkMaterialCount(5, 1, MaterialType::Lava) == 20);
+
+        // The tick itself and each catch-up round react the pair once
+        world.ClearFocusRects();
+        world.Update();
+        REQUIRE(world.GetCellsReactionCheckedLastUpdate() > 40);
+        REQUIRE(world.GetChunkMaterialCount(5, 1, MaterialType::Lava) < 20);
+    }
+}
+
+TEST_CASE("World state hash", "[World][Hash]") {
+    World serial(256, 256);
+    World parallel(256, 256, WorldStorage::Sparse);
+    serial.SetSeed(42);
+    parallel.SetSeed(42);
+    parallel.SetThreadCount(4);
+    FillTestScene(serial);
+    FillTestScene(parallel);
+
+    SECTION("Identical runs hash identically every tick") {
+        for (int i = 0; i < 100; i++) {
+            serial.Update();
+            parallel.Update();
+            REQUIRE(serial.GetStateHash() == parallel.GetStateHash());
+        }
+    }
+
+    SECTION("Any difference in cells changes the hash") {
+        serial.Update();
+        parallel.Update();
+        REQUIRE(serial.GetStateHash() == parallel.GetStateHash());
+
+        parallel.SetPixel(0, 0, MaterialType::Stone);
+        serial.Update();
+        parallel.Update();
+        REQUIRE(serial.GetStateHash() != parallel.GetStateHash());
+
+        parallel.SetPixel(0, 0, MaterialType::Air);
+        serial.Update();
+        parallel.Update();
+        REQUIRE(serial.GetStateHash() == parallel.GetStateHash());
+    }
+
+    SECTION("Differences in velocity or timers change the hash") {
+        serial.Update();
+        parallel.Update();
+        parallel.SetVelocity(10, 255, 0, 3);
+        serial.Update();
+        parallel.Update();
+        REQUIRE(serial.GetStateHash() != parallel.GetStateHash());
+
+        parallel.SetVelocity(10, 255, 0, 0);
+        parallel.SetTimer(12, 255, 1000);
+        serial.Update();
+        parallel.Update();
+        REQUIRE(serial.GetStateHash() != parallel.GetStateHash());
+
+        parallel.SetTimer(12, 255, 0);
+        serial.Update();
+        parallel.Update();
+        REQUIRE(serial.GetStateHash() == parallel.GetStateHash());
+    }
+
+    SECTION("Heat differences change the hash") {
+        World heated(256, 256);
+        heated.SetSeed(42);
+        FillTestScene(heated);
+        serial.Update();
+        heated.Update();
+        REQUIRE(serial.GetStateHash() == heated.GetStateHash());
+
+        heated.AddHeat(200, 20, 5.0f);
+        serial.Update();
+        heated.Update();
+        REQUIRE(serial.GetStateHash() != heated.GetStateHash());
+        REQUIRE(serial.GetContentHash() == heated.GetContentHash());
+    }
+
+    SECTION("Cleared worlds hash like empty ones") {
+        World empty(256, 256);
+        serial.Update();
+        serial.Clear();
+        serial.Update();
+        empty.Update();
+        empty.Update();
+        REQUIRE(serial.GetStateHash() == empty.GetStateHash());
+    }
+
+    SECTION("Content hashes are kept current by every write") {
+        REQUIRE(serial.GetContentHash() == parallel.GetContentHash());
+        REQUIRE(serial.GetContentHash() != World(256, 256).GetContentHash());
+
+        uint64_t before = serial.GetContentHash();
+        uint64_t chunkBefore = serial.GetChunkContentHash(0, 0);
+        uint64_t neighbourBefore = serial.GetChunkContentHash(1, 0);
+        serial.SetPixel(5, 5, MaterialType::Stone);
+        REQUIRE(serial.GetContentHash() != before);
+        REQUIRE(serial.GetChunkContentHash(0, 0) != chunkBefore);
+        REQUIRE(serial.GetChunkContentHash(1, 0) == neighbourBefore);
+        serial.SetPixel(5, 5, MaterialType::Air);
+        REQUIRE(serial.GetContentHash() == before);
+    }
+
+    SECTION("Incremental content hashes match a world rebuilt from the cells") {
+        for (int i = 0; i < 60; i++) {
+            serial.Update();
+            parallel.Update();
+        }
+        REQUIRE(serial.GetContentHash() == parallel.GetContentHash());
+
+        World rebuilt(256, 256);
+        for (int y = 0; y < 256; y++) {
+            for (int x = 0; x < 256; x++) {
+                rebuilt.SetPixel(x, y, parallel.GetPixel(x, y));
+            }
+        }
+        REQUIRE(rebuilt.GetContentHash() == parallel.GetContentHash());
+        REQUIRE(rebuilt.GetChunkContentHash(3, 3) == parallel.GetChunkContentHash(3, 3));
+    }
+}
+
+TEST_CASE("World checkpoints", "[World][Checkpoint]") {
+    World dense(256, 256);
+    World sparse(256, 256, WorldStorage::Sparse);
+    FillTestScene(dense);
+    FillTestScene(sparse);
+
+    SECTION("Taking a checkpoint copies nothing until a chunk is written") {
+        uint64_t id = dense.TakeCheckpoint();
+        REQUIRE(id != 0);
+        REQUIRE(dense.GetCheckpointCount() == 1);
+        REQUIRE(dense.GetCheckpointChunkCount() == 0);
+
+        dense.SetPixel(5, 5, MaterialType::Stone);
+        dense.SetPixel(6, 5, MaterialType::Stone);
+        REQUIRE(dense.GetCheckpointChunkCount() == 1);
+        dense.SetPixel(200, 5, MaterialType::Stone);
+        REQUIRE(dense.GetCheckpointChunkCount() == 2);
+
+        REQUIRE(dense.RestoreCheckpoint(id));
+        REQUIRE(dense.GetPixel(5, 5) == MaterialType::Air);
+        REQUIRE(dense.GetCheckpointCount() == 0);
+        REQUIRE_FALSE(dense.RestoreCheckpoint(id));
+    }
+
+    SECTION("Undoing a clear restores every cell, count and hash") {
+        for (World* world : {&dense, &sparse}) {
+            World reference(256, 256);
+            FillTestScene(reference);
+            uint64_t hash = world->GetContentHash();
+
+            uint64_t id = world->TakeCheckpoint();
+            world->Clear();
+            REQUIRE(world->GetContentHash() == 0);
+            // Only chunks that held something are copied
+            REQUIRE(world->GetCheckpointChunkCount() < static_cast<size_t>(4 * 4));
+
+            REQUIRE(world->RestoreCheckpoint(id));
+            REQUIRE(world->GetContentHash() == hash);
+            REQUIRE(SameCells(*world, reference));
+            REQUIRE(world->GetChunkMaterialCount(1, 3, MaterialType::Stone) ==
+                    reference.GetChunkMaterialCount(1, 3, MaterialType::Stone));
+            REQUIRE(world->IsChunkAwake(1, 0));
+        }
+    }
+
+    SECTION("Restoring after the simulation ran rewinds to the checkpoint") {
+        dense.SetThreadCount(4);
+        sparse.SetThreadCount(4);
+        for (int i = 0; i < 10; i++) {
+            dense.Update();
+            sparse.Update();
+        }
+        uint64_t hash = dense.GetContentHash();
+        uint64_t denseId = dense.TakeCheckpoint();
+        uint64_t sparseId = sparse.TakeCheckpoint();
+        for (int i = 0; i < 60; i++) {
+            dense.Update();
+            sparse.Update();
+        }
+        REQUIRE(dense.GetContentHash() != hash);
+
+        REQUIRE(dense.RestoreCheckpoint(denseId));
+        REQUIRE(sparse.RestoreCheckpoint(sparseId));
+        REQUIRE(dense.GetContentHash() == hash);
+        REQUIRE(sparse.GetContentHash() == hash);
+        REQUIRE(SameCells(dense, sparse));
+
+        // Both carry on identically from the restored cells
+        for (int i = 0; i < 20; i++) {
+            dense.Update();
+            sparse.Update();
+        }
+        REQUIRE(SameCells(dense, sparse));
+    }
+
+    SECTION("Undo after further ticks restores the changed chunks and no others") {
+        World world(512, 256);
+        world.FillRect(0, 255, 511, 255, MaterialType::Stone);
+        world.FillRect(20, 230, 60, 254, MaterialType::Sand);
+        for (int i = 0; i < 1000; i++) {
+            world.Update();
+            if (world.GetCellsScannedLastUpdate() == 0) {
+                break;
+            }
+        }
+        REQUIRE(world.GetCellsScannedLastUpdate() == 0);
+        std::vector<MaterialType> before(512 * 256);
+        world.CopyRegion(0, 0, 512, 256, before.data(), 512);
+
+        uint64_t id = world.TakeCheckpoint();
+        world.FillRect(300, 10, 320, 30, MaterialType::Sand);
+        for (int i = 0; i < 40; i++) {
+            world.Update();
+        }
+        REQUIRE(world.GetCheckpointChunkCount() > 0);
+        std::vector<uint64_t> stamps;
+        for (int cy = 0; cy < 4; cy++) {
+            for (int cx = 0; cx < 3; cx++) {
+                stamps.push_back(world.GetChunkChangeStamp(cx, cy));
+            }
+        }
+
+        REQUIRE(world.RestoreCheckpoint(id));
+        std::vector<MaterialType> after(512 * 256);
+        world.CopyRegion(0, 0, 512, 256, after.data(), 512);
+        REQUIRE(after == before);
+        // The settled pile far from the command was neither saved nor rewritten
+        for (int cy = 0; cy < 4; cy++) {
+            for (int cx = 0; cx < 3; cx++) {
+                REQUIRE(world.GetChunkChangeStamp(cx, cy) == stamps[cy * 3 + cx]);
+                REQUIRE_FALSE(world.IsChunkAwake(cx, cy));
+            }
+        }
+        REQUIRE(world.IsChunkAwake(4, 0));
+    }
+
+    SECTION("Nested checkpoints restore in either order") {
+        uint64_t first = dense.TakeCheckpoint();
+        dense.SetPixel(5, 5, MaterialType::Stone);
+        uint64_t second = dense.TakeCheckpoint();
+        dense.SetPixel(6, 5, MaterialType::Stone);
+        dense.SetPixel(200, 200, MaterialType::Stone);
+
+        REQUIRE(dense.RestoreCheckpoint(second));
+        REQUIRE(dense.GetPixel(5, 5) == MaterialType::Stone);
+        REQUIRE(dense.GetPixel(6, 5) == MaterialType::Air);
+        REQUIRE(dense.GetPixel(200, 200) == MaterialType::Air);
+
+        REQUIRE(dense.RestoreCheckpoint(first));
+        REQUIRE(dense.GetPixel(5, 5) == MaterialType::Air);
+        REQUIRE(dense.GetCheckpointCount() == 0);
+    }
+
+    SECTION("Releasing a newer checkpoint keeps older ones whole") {
+        uint64_t hash = dense.GetContentHash();
+        uint64_t first = dense.TakeCheckpoint();
+        uint64_t second = dense.TakeCheckpoint();
+        dense.SetPixel(200, 200, MaterialType::Stone);
+        dense.ReleaseCheckpoint(second);
+        REQUIRE(dense.GetCheckpointCount() == 1);
+        REQUIRE(dense.GetCheckpointChunkCount() == 1);
+
+        dense.SetPixel(201, 200, MaterialType::Stone);
+        REQUIRE(dense.RestoreCheckpoint(first));
+        REQUIRE(dense.GetContentHash() == hash);
+    }
+
+    SECTION("Timers resume with the ticks they had left") {
+        dense.SetPixel(10, 150, MaterialType::Fire);
+        dense.SetTimer(10, 150, 100);
+        uint64_t id = dense.TakeCheckpoint();
+        for (int i = 0; i < 10; i++) {
+            dense.Update();
+        }
+        REQUIRE(dense.RestoreCheckpoint(id));
+        REQUIRE(dense.GetPixel(10, 150) == MaterialType::Fire);
+        REQUIRE(dense.GetTimer(10, 150) == 100);
+    }
+
+    SECTION("A grain stopped without moving gets its fall speed back") {
+        World denseShaft(128, 128);
+        World sparseShaft(128, 128, WorldStorage::Sparse);
+        for (World* world : {&denseShaft, &sparseShaft}) {
+            world->FillRect(9, 0, 9, 120, MaterialType::Stone);
+            world->FillRect(11, 0, 11, 120, MaterialType::Stone);
+            world->FillRect(10, 120, 10, 120, MaterialType::Stone);
+            world->SetPixel(10, 10, MaterialType::Sand);
+            for (int i = 0; i < 200 && world->GetPixel(10, 119) != MaterialType::Sand; i++) {
+                world->Update();
+            }
+            REQUIRE(world->GetPixel(10, 119) == MaterialType::Sand);
+            int landing = world->GetVelocityY(10, 119);
+            REQUIRE(landing > 0);
+
+            // The next tick only clears the speed of the blocked grain
+            uint64_t id = world->TakeCheckpoint();
+            world->Update();
+            REQUIRE(world->GetPixel(10, 119) == MaterialType::Sand);
+            REQUIRE(world->GetVelocityY(10, 119) == 0);
+
+            REQUIRE(world->RestoreCheckpoint(id));
+            REQUIRE(world->GetVelocityY(10, 119) == landing);
+        }
+    }
+
+    SECTION("Checkpoints beyond the budget are dropped oldest first") {
+        World world(256, 256);
+        // Room for three chunk copies
+        world.SetCheckpointBudget(3 * 64 * 64);
+        uint64_t first = world.TakeCheckpoint();
+        world.SetPixel(5, 5, MaterialType::Stone);
+        world.SetPixel(70, 5, MaterialType::Stone);
+        uint64_t second = world.TakeCheckpoint();
+        world.SetPixel(5, 70, MaterialType::Stone);
+        world.SetPixel(70, 70, MaterialType::Stone);
+        REQUIRE(world.GetCheckpointBytes() > world.GetCheckpointBudget());
+
+        // The newest checkpoint is kept however much it holds
+        world.Update();
+        REQUIRE(world.GetCheckpointCount() == 1);
+        REQUIRE_FALSE(world.HasCheckpoint(first));
+        REQUIRE(world.HasCheckpoint(second));
+
+        world.SetPixel(200, 200, MaterialType::Stone);
+        REQUIRE(world.RestoreCheckpoint(second));
+        REQUIRE(world.GetPixel(5, 5) == MaterialType::Stone);
+        REQUIRE(world.GetPixel(5, 70) == MaterialType::Air);
+        REQUIRE(world.GetPixel(200, 200) == MaterialType::Air);
+        REQUIRE(world.GetCheckpointBytes() == 0);
+    }
+}
+
+TEST_CASE("World bulk writes", "[World][Bulk]") {
+    SECTION("FillRect and FillCircle match SetPixel cell by cell") {
+        for (bool planes : {false, true}) {
+            World bulk(200, 200);
+            World cells(200, 200);
+            bulk.SetPowderBitPlanes(planes);
+            cells.SetPowderBitPlanes(planes);
+
+            bulk.FillRect(-5, 190, 250, 199, MaterialType::Stone);
+            bulk.FillRect(40, 20, 130, 60, MaterialType::Sand);
+            bulk.FillCircle(150, 100, 12, MaterialType::Water);
+            bulk.FillCircle(0, 0, 9, MaterialType::Fire);
+            for (int y = 0; y < 200; y++) {
+                for (int x = 0; x < 200; x++) {
+                    int dx = x - 150;
+                    int dy = y - 100;
+                    if (y >= 190) {
+                        cells.SetPixel(x, y, MaterialType::Stone);
+                    } else if (x >= 40 && x <= 130 && y >= 20 && y <= 60) {
+                        cells.SetPixel(x, y, MaterialType::Sand);
+                    } else if (dx * dx + dy * dy <= 144) {
+                        cells.SetPixel(x, y, MaterialType::Water);
+                    } else if (x * x + y * y <= 81) {
+                        cells.SetPixel(x, y, MaterialType::Fire);
+                    }
+                }
+            }
+
+            REQUIRE(SameCells(bulk, cells));
+            REQUIRE(bulk.GetContentHash() == cells.GetContentHash());
+            REQUIRE(bulk.GetChunkMaterialCount(1, 0, MaterialType::Sand) ==
+                    cells.GetChunkMaterialCount(1, 0, MaterialType::Sand));
+            REQUIRE(bulk.GetTimer(3, 3) == cells.GetTimer(3, 3));
+            REQUIRE(bulk.GetTimer(3, 3) > 0);
+
+            for (int i = 0; i < 40; i++) {
+                bulk.Update();
+                cells.Update();
+            }
+            REQUIRE(SameCells(bulk, cells));
+        }
+    }
+
+    SECTION("Writes that change nothing leave the world asleep") {
+        World world(128, 128);
+        world.FillRect(0, 0, 127, 127, MaterialType::Air);
+        REQUIRE_FALSE(world.IsChunkAwake(0, 0));
+        world.FillRect(10, 10, 20, 20, MaterialType::Stone);
+        REQUIRE(world.IsChunkAwake(0, 0));
+        REQUIRE_FALSE(world.IsChunkAwake(1, 1));
+    }
+
+    SECTION("Sparse worlds only allocate chunks that receive material") {
+        World world(1024, 1024, WorldStorage::Sparse);
+        world.FillRect(0, 0, 1023, 1023, MaterialType::Air);
+        world.FillCircle(500, 500, 50, MaterialType::Air);
+        REQUIRE(world.GetAllocatedChunkCount() == 0);
+
+        world.FillRect(10, 10, 100, 20, MaterialType::Stone);
+        REQUIRE(world.GetAllocatedChunkCount() == 2);
+        REQUIRE(world.GetChunkMaterialCount(1, 0, MaterialType::Stone) == 37 * 11);
+    }
+
+    SECTION("Blit pastes cells, honouring a mask") {
+        World world(100, 100);
+        world.FillRect(0, 0, 99, 99, MaterialType::Stone);
+        const MaterialType cells[] = {MaterialType::Sand, MaterialType::Water,
+                                      MaterialType::Air, MaterialType::Sand};
+        const uint8_t mask[] = {1, 0, 1, 1};
+        world.Blit(98, 50, 2, 2, cells, 2, mask);
+        REQUIRE(world.GetPixel(98, 50) == MaterialType::Sand);
+        REQUIRE(world.GetPixel(99, 50) == MaterialType::Stone);
+        REQUIRE(world.GetPixel(98, 51) == MaterialType::Air);
+        REQUIRE(world.GetPixel(99, 51) == MaterialType::Sand);
+
+        // Clipped at the edges
+        world.Blit(-1, -1, 2, 2, cells, 2);
+        REQUIRE(world.GetPixel(0, 0) == MaterialType::Sand);
+    }
+
+    SECTION("CopyRegion and world to world Blit round trip") {
+        World dense(256, 256);
+        World sparse(256, 256, WorldStorage::Sparse);
+        FillTestScene(dense);
+        sparse.Blit(dense, 0, 0, 256, 256, 0, 0);
+        REQUIRE(SameCells(dense, sparse));
+        REQUIRE(sparse.GetContentHash() == dense.GetContentHash());
+
+        MaterialType region[4 * 4];
+        dense.CopyRegion(254, 254, 4, 4, region, 4);
+        REQUIRE(region[0] == dense.GetPixel(254, 254));
+        REQUIRE(region[1 * 4 + 1] == dense.GetPixel(255, 255));
+        REQUIRE(region[3] == MaterialType::Stone);
+        REQUIRE(region[3 * 4] == MaterialType::Stone);
+
+        // Overlapping copies within one world read the original cells
+        World moved(256, 256);
+        FillTestScene(moved);
+        moved.Blit(moved, 0, 0, 200, 100, 10, 5);
+        for (int y = 0; y < 100; y++) {
+            for (int x = 0; x < 200; x++) {
+                REQUIRE(moved.GetPixel(x + 10, y + 5) == dense.GetPixel(x, y));
+            }
+        }
+    }
+
+    SECTION("Bulk writes are undone by checkpoints") {
+        World world(256, 256);
+        FillTestScene(world);
+        uint64_t hash = world.GetContentHash();
+        uint64_t id = world.TakeCheckpoint();
+        world.FillRect(0, 0, 255, 255, MaterialType::Water);
+        REQUIRE(world.RestoreCheckpoint(id));
+        REQUIRE(world.GetContentHash() == hash);
+    }
+}
+
+
+TEST_CASE("World edges", "[World][Border]") {
+    SECTION("Cells just outside the world read as Stone, also after Clear") {
+        World world(100, 80);
+        world.FillRect(0, 0, 99, 79, MaterialType::Water);
+        world.Clear();
+
+        const int outside[][2] = {{-1, -1}, {-1, 40}, {100, 0}, {100, 80}, {50, -1}, {0, 80}, {-5, 500}};
+        for (const auto& cell : outside) {
+            REQUIRE(world.GetPixel(cell[0], cell[1]) == MaterialType::Stone);
+        }
+        REQUIRE(world.GetPixel(0, 0) == MaterialType::Air);
+        REQUIRE(world.GetPixel(99, 79) == MaterialType::Air);
+    }
+
+    SECTION("Cells settle against every edge alike in dense and sparse storage") {
+        // Neither side is a whole number of chunks
+        World dense(150, 100);
+        World sparse(150, 100, WorldStorage::Sparse);
+        for (World* world : {&dense, &sparse}) {
+            world->FillRect(0, 0, 3, 40, MaterialType::Sand);
+            world->FillRect(146, 0, 149, 40, MaterialType::Sand);
+            world->FillRect(60, 90, 90, 99, MaterialType::Water);
+            world->FillRect(0, 99, 5, 99, MaterialType::Water);
+        }
+        auto count = [](const World& world, MaterialType material) {
+            int total = 0;
+            for (int cy = 0; cy < world.GetChunkCountY(); cy++) {
+                for (int cx = 0; cx < world.GetChunkCountX(); cx++) {
+                    total += world.GetChunkMaterialCount(cx, cy, material);
+                }
+            }
+            return total;
+        };
+        int sand = count(dense, MaterialType::Sand);
+        int water = count(dense, MaterialType::Water);
+
+        for (int i = 0; i < 200; i++) {
+            dense.Update();
+            sparse.Update();
+        }
+
+        REQUIRE(SameCells(dense, sparse));
+        REQUIRE(count(dense, MaterialType::Sand) == sand);
+        REQUIRE(count(dense, MaterialType::Water) == water);
+        REQUIRE(dense.GetPixel(0, 99) != MaterialType::Air);
+        REQUIRE(dense.GetPixel(149, 99) != MaterialType::Air);
+        REQUIRE(dense.GetPixel(-1, 99) == MaterialType::Stone);
+        REQUIRE(dense.GetPixel(150, 99) == MaterialType::Stone);
+    }
+}
@@ -0,0 +1,112 @@
+#include "../external/catch_amalgamated.hpp"
+#include "../../modules/world/WorldSnapshot.h"
+#include "../../modules/world/World.h"
+#include <atomic>
+#include <thread>
+
+TEST_CASE("WorldSnapshot publishing", "[WorldSnapshot]") {
+    World world(200, 100);
+    WorldSnapshot snapshot(200, 100);
+    const size_t chunks = world.GetChunkCountX() * world.GetChunkCountY();
+
+    SECTION("Frames are air until the first publish") {
+        const WorldSnapshot::Frame& frame = snapshot.Acquire();
+        REQUIRE(frame.width == 200);
+        REQUIRE(frame.height == 100);
+        REQUIRE(frame.GetPixel(150, 90) == MaterialType::Air);
+    }
+
+    SECTION("Acquire returns the latest published frame") {
+        world.SetPixel(150, 90, MaterialType::Stone);
+        world.SetPixel(3, 4, MaterialType::Water);
+        world.Update();
+        snapshot.Publish(world);
+
+        const WorldSnapshot::Frame& frame = snapshot.Acquire();
+        REQUIRE(frame.tick == 1);
+        REQUIRE(frame.GetPixel(150, 90) == MaterialType::Stone);
+        for (int y = 0; y < 100; y++) {
+            for (int x = 0; x < 200; x++) {
+                REQUIRE(frame.GetPixel(x, y) == world.GetPixel(x, y));
+            }
+        }
+
+        world.Update();
+        snapshot.Publish(world);
+        world.Update();
+        snapshot.Publish(world);
+        REQUIRE(snapshot.Acquire().tick == 3);
+        REQUIRE(&snapshot.Acquire() == &snapshot.Acquire());
+    }
+
+    SECTION("Only changed chunks are copied") {
+        for (int i = 0; i < 3; i++) {
+            snapshot.Acquire();
+            snapshot.Publish(world);
+            REQUIRE(snapshot.GetChunksCopiedLastPublish() == chunks);
+        }
+        snapshot.Acquire();
+        snapshot.Publish(world);
+        REQUIRE(snapshot.GetChunksCopiedLastPublish() == 0);
+
+        world.SetPixel(70, 70, MaterialType::Stone);
+        snapshot.Acquire();
+        snapshot.Publish(world);
+        REQUIRE(snapshot.GetChunksCopiedLastPublish() == 1);
+        REQUIRE(snapshot.Acquire().GetPixel(70, 70) == MaterialType::Stone);
+
+        // Every frame picks the change up on its next turn
+        for (int i = 0; i < 3; i++) {
+            snapshot.Acquire();
+            world.Update();
+            snapshot.Publish(world);
+            REQUIRE(snapshot.Acquire().GetPixel(70, 70) == MaterialType::Stone);
+        }
+        world.Update();
+        snapshot.Acquire();
+        snapshot.Publish(world);
+        REQUIRE(snapshot.GetChunksCopiedLastPublish() == 0);
+    }
+
+    SECTION("Particles are part of the frame") {
+        world.SetPixel(10, 10, MaterialType::Sand);
+        REQUIRE(world.EjectPixel(10, 10, 1.0f, -1.0f));
+        snapshot.Publish(world);
+
+        const WorldSnapshot::Frame& frame = snapshot.Acquire();
+        REQUIRE(frame.particles.size() == 1);
+        REQUIRE(frame.particles[0].material == MaterialType::Sand);
+        REQUIRE(frame.GetPixel(10, 10) == MaterialType::Air);
+    }
+
+    SECTION("A reader on another thread only sees whole frames") {
+        std::atomic<bool> done{false};
+        std::atomic<bool> torn{false};
+        std::thread reader([&]() {
+            uint64_t lastTick = 0;
+            while (!done.load()) {
+                const WorldSnapshot::Frame& frame = snapshot.Acquire();
+                MaterialType first = frame.GetPixel(0, 0);
+                for (MaterialType cell : frame.cells) {
+                    if (cell != first) torn = true;
+                }
+                if (frame.tick < lastTick) torn = true;
+                lastTick = frame.tick;
+            }
+        });
+
+        for (int i = 0; i < 100; i++) {
+            MaterialType material = i % 2 ? MaterialType::Stone : MaterialType::Sand;
+            for (int y = 0; y < 100; y++) {
+                for (int x = 0; x < 200; x++) {
+                    world.SetPixel(x, y, material);
+                }
+            }
+            snapshot.Publish(world);
+        }
+        done = true;
+        reader.join();
+
+        REQUIRE_FALSE(torn.load());
+    }
+}